@@ -0,0 +1,603 @@
+#include <crbtree.h>
+#include <getopt.h>
+#include <math.h>
+#include <rbtree.h>
+#include <rbtree_bucket.h>
+#include <rbtree_frozen.h>
+#include <rbtree_lean.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "std_multiset.h"
+
+// Every configuration runs in its own child process, so the reported peak RSS
+// belongs to that configuration alone. Results are printed one JSON object per
+// line; latency percentiles come from timing every SAMPLE_EVERY-th operation.
+// A timed op cannot overlap its cache misses with its neighbours, so p50 can
+// sit above ns_mean, which is the untimed wall clock divided by the op count.
+#define SAMPLE_EVERY 16
+#define MAX_LIST 32
+
+typedef struct
+{
+  const char *name;
+  void *(*create)(void);
+  void (*build)(void *, const key_t *, size_t);  // prefill, NULL to insert one by one
+  void (*insert)(void *, key_t);                  // NULL for read-only baselines
+  int (*find)(void *, key_t);
+  int (*erase)(void *, key_t);
+  void (*destroy)(void *);
+} bench_impl;
+
+typedef struct
+{
+  const char *name;
+  int insert_pct, erase_pct;  // the rest are finds
+} bench_workload;
+
+enum
+{
+  OP_INSERT,
+  OP_ERASE,
+  OP_FIND
+};
+
+typedef struct
+{
+  int kind;
+  key_t key;
+} bench_op;
+
+// ---- implementations under test ----
+
+static void *rbtree_create(void)
+{
+  return new_rbtree();
+}
+
+static void *rbtree_pool_create(void)
+{
+  const rbtree_config config = {.pool_chunk = 4096};
+  return new_rbtree_ex(&config);
+}
+
+static void rbtree_insert_op(void *t, key_t key)
+{
+  rbtree_insert((rbtree *)t, key);
+}
+
+static int rbtree_find_op(void *t, key_t key)
+{
+  return rbtree_find((rbtree *)t, key) != NULL;
+}
+
+static int rbtree_erase_op(void *t, key_t key)
+{
+  node_t *p = rbtree_find((rbtree *)t, key);
+  if (p == NULL)
+  {
+    return 0;
+  }
+  rbtree_erase((rbtree *)t, p);
+  return 1;
+}
+
+static void rbtree_destroy(void *t)
+{
+  delete_rbtree((rbtree *)t);
+}
+
+static void *crbtree_create(void)
+{
+  return new_crbtree();
+}
+
+static void crbtree_insert_op(void *t, key_t key)
+{
+  crbtree_insert((crbtree *)t, key);
+}
+
+static int crbtree_find_op(void *t, key_t key)
+{
+  return crbtree_find((crbtree *)t, key) != 0;
+}
+
+static int crbtree_erase_op(void *t, key_t key)
+{
+  const crb_index p = crbtree_find((crbtree *)t, key);
+  if (p == 0)
+  {
+    return 0;
+  }
+  crbtree_erase((crbtree *)t, p);
+  return 1;
+}
+
+static void crbtree_destroy(void *t)
+{
+  delete_crbtree((crbtree *)t);
+}
+
+static void *lrbtree_create(void)
+{
+  return new_lrbtree();
+}
+
+static void lrbtree_insert_op(void *t, key_t key)
+{
+  lrbtree_insert((lrbtree *)t, key);
+}
+
+static int lrbtree_find_op(void *t, key_t key)
+{
+  return lrbtree_find((lrbtree *)t, key) != NULL;
+}
+
+static int lrbtree_erase_op(void *t, key_t key)
+{
+  return lrbtree_erase((lrbtree *)t, key);
+}
+
+static void lrbtree_destroy(void *t)
+{
+  delete_lrbtree((lrbtree *)t);
+}
+
+static void *brbtree_create(void)
+{
+  return new_brbtree();
+}
+
+static void brbtree_insert_op(void *t, key_t key)
+{
+  brbtree_insert((brbtree *)t, key);
+}
+
+static int brbtree_find_op(void *t, key_t key)
+{
+  return brbtree_find((brbtree *)t, key) != NULL;
+}
+
+static int brbtree_erase_op(void *t, key_t key)
+{
+  return brbtree_erase((brbtree *)t, key);
+}
+
+static void brbtree_destroy(void *t)
+{
+  delete_brbtree((brbtree *)t);
+}
+
+typedef struct
+{
+  key_t *keys;
+  size_t n;
+} sorted_array;
+
+static int key_compare(const void *a, const void *b)
+{
+  const key_t x = *(const key_t *)a, y = *(const key_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void *sorted_array_create(void)
+{
+  return calloc(1, sizeof(sorted_array));
+}
+
+static void sorted_array_build(void *p, const key_t *keys, size_t n)
+{
+  sorted_array *a = (sorted_array *)p;
+  a->keys = malloc((n > 0 ? n : 1) * sizeof(key_t));
+  memcpy(a->keys, keys, n * sizeof(key_t));
+  qsort(a->keys, n, sizeof(key_t), key_compare);
+  a->n = n;
+}
+
+static int sorted_array_find(void *p, key_t key)
+{
+  const sorted_array *a = (const sorted_array *)p;
+  return bsearch(&key, a->keys, a->n, sizeof(key_t), key_compare) != NULL;
+}
+
+static void sorted_array_destroy(void *p)
+{
+  free(((sorted_array *)p)->keys);
+  free(p);
+}
+
+static void *frozen_create(void)
+{
+  return calloc(1, sizeof(rbtree_frozen *));
+}
+
+static void frozen_build(void *p, const key_t *keys, size_t n)
+{
+  rbtree *t = rbtree_from_array(keys, n);
+  *(rbtree_frozen **)p = rbtree_freeze(t);
+  delete_rbtree(t);
+}
+
+static int frozen_find(void *p, key_t key)
+{
+  return rbtree_frozen_find(*(rbtree_frozen **)p, key) != NULL;
+}
+
+static void frozen_destroy(void *p)
+{
+  delete_rbtree_frozen(*(rbtree_frozen **)p);
+  free(p);
+}
+
+static const bench_impl impls[] = {
+    {"rbtree", rbtree_create, NULL, rbtree_insert_op, rbtree_find_op, rbtree_erase_op, rbtree_destroy},
+    {"rbtree_pool", rbtree_pool_create, NULL, rbtree_insert_op, rbtree_find_op, rbtree_erase_op, rbtree_destroy},
+    {"crbtree", crbtree_create, NULL, crbtree_insert_op, crbtree_find_op, crbtree_erase_op, crbtree_destroy},
+    {"std_multiset", std_multiset_create, NULL, std_multiset_insert, std_multiset_find, std_multiset_erase,
+     std_multiset_destroy},
+    {"lrbtree", lrbtree_create, NULL, lrbtree_insert_op, lrbtree_find_op, lrbtree_erase_op, lrbtree_destroy},
+    {"brbtree", brbtree_create, NULL, brbtree_insert_op, brbtree_find_op, brbtree_erase_op, brbtree_destroy},
+    {"sorted_array", sorted_array_create, sorted_array_build, NULL, sorted_array_find, NULL,
+     sorted_array_destroy},
+    {"rbtree_frozen", frozen_create, frozen_build, NULL, frozen_find, NULL, frozen_destroy},
+};
+
+static const bench_workload workloads[] = {
+    {"insert-heavy", 80, 10},
+    {"erase-heavy", 40, 55},  // settles where inserts and successful erases balance
+    {"find-heavy", 5, 5},
+    {"find-only", 0, 0},
+};
+
+static const char *dists[] = {"sequential", "uniform", "zipf"};
+
+// ---- key generation ----
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t rng_next(void)
+{
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+static double rng_unit(void)
+{
+  return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Zipfian ranks in [0, n) with skew theta (Gray et al., as used by YCSB)
+typedef struct
+{
+  double theta, alpha, zetan, eta;
+  size_t n;
+} zipf_gen;
+
+static void zipf_init(zipf_gen *z, const size_t n, const double theta)
+{
+  double zetan = 0;
+  for (size_t i = 1; i <= n; i++)
+  {
+    zetan += 1.0 / pow((double)i, theta);
+  }
+  const double zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+  z->theta = theta;
+  z->n = n;
+  z->zetan = zetan;
+  z->alpha = 1.0 / (1.0 - theta);
+  z->eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+}
+
+static size_t zipf_next(const zipf_gen *z)
+{
+  const double u = rng_unit();
+  const double uz = u * z->zetan;
+  if (uz < 1.0)
+  {
+    return 0;
+  }
+  if (uz < 1.0 + pow(0.5, z->theta))
+  {
+    return 1 < z->n ? 1 : 0;
+  }
+  const size_t r = (size_t)((double)z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+  return r < z->n ? r : z->n - 1;
+}
+
+// Fill prefill[0..n) and the op stream. Sequential keys behave like a queue
+// (insert at the high end, erase at the low end); uniform keys are drawn from
+// [0, 2n) so about half of the finds hit; zipf keys are hot picks among the
+// prefilled keys.
+static void generate(const char *dist, const bench_workload *w, key_t *prefill, const size_t n, bench_op *ops,
+                     const size_t nops)
+{
+  const uint64_t space = (2 * (uint64_t)n < (uint64_t)INT32_MAX) ? 2 * (uint64_t)n + 1 : (uint64_t)INT32_MAX;
+  const int seq = strcmp(dist, "sequential") == 0;
+  const int zipf = strcmp(dist, "zipf") == 0;
+  zipf_gen z = {0};
+
+  for (size_t i = 0; i < n; i++)
+  {
+    prefill[i] = seq ? (key_t)i : (key_t)(rng_next() % space);
+  }
+  if (zipf && n > 0)
+  {
+    zipf_init(&z, n, 0.99);
+  }
+
+  key_t lo = 0, hi = (key_t)n;
+  for (size_t i = 0; i < nops; i++)
+  {
+    const int pct = (int)(rng_next() % 100);
+    ops[i].kind = pct < w->insert_pct ? OP_INSERT : pct < w->insert_pct + w->erase_pct ? OP_ERASE : OP_FIND;
+    if (seq)
+    {
+      if (ops[i].kind == OP_INSERT)
+      {
+        ops[i].key = hi++;
+      }
+      else if (ops[i].kind == OP_ERASE && lo < hi)
+      {
+        ops[i].key = lo++;
+      }
+      else
+      {
+        ops[i].key = lo + (hi > lo ? (key_t)(rng_next() % (uint64_t)(hi - lo)) : 0);
+      }
+    }
+    else if (zipf && n > 0)
+    {
+      ops[i].key = prefill[zipf_next(&z)];
+    }
+    else
+    {
+      ops[i].key = (key_t)(rng_next() % space);
+    }
+  }
+}
+
+// ---- measurement ----
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// cost of the clock_gettime pair around one sampled op, subtracted from samples
+static uint64_t timer_overhead(void)
+{
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < 1000; i++)
+  {
+    const uint64_t t0 = now_ns();
+    const uint64_t d = now_ns() - t0;
+    best = d < best ? d : best;
+  }
+  return best;
+}
+
+static int u64_compare(const void *a, const void *b)
+{
+  const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, const size_t n, const double q)
+{
+  if (n == 0)
+  {
+    return 0;
+  }
+  size_t i = (size_t)(q * (double)n);
+  return sorted[i < n ? i : n - 1];
+}
+
+static volatile size_t sink;  // keeps find results alive
+
+static int run_one(const bench_impl *impl, const char *dist, const bench_workload *w, const size_t n,
+                   const size_t nops, const uint64_t seed)
+{
+  rng_state = seed ? seed : rng_state;
+  key_t *prefill = malloc((n > 0 ? n : 1) * sizeof(key_t));
+  bench_op *ops = malloc((nops > 0 ? nops : 1) * sizeof(bench_op));
+  uint64_t *samples = malloc((nops / SAMPLE_EVERY + 1) * sizeof(uint64_t));
+  generate(dist, w, prefill, n, ops, nops);
+
+  void *s = impl->create();
+  uint64_t t0 = now_ns();
+  if (impl->build != NULL)
+  {
+    impl->build(s, prefill, n);
+  }
+  else
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      impl->insert(s, prefill[i]);
+    }
+  }
+  const uint64_t build_ns = now_ns() - t0;
+  free(prefill);
+
+  const uint64_t overhead = timer_overhead();
+  size_t nsamples = 0, hits = 0;
+  long live = (long)n;
+  t0 = now_ns();
+  for (size_t i = 0; i < nops; i++)
+  {
+    const int sampled = (i % SAMPLE_EVERY) == 0;
+    const uint64_t s0 = sampled ? now_ns() : 0;
+    switch (ops[i].kind)
+    {
+    case OP_INSERT:
+      impl->insert(s, ops[i].key);
+      live++;
+      break;
+    case OP_ERASE:
+      if (impl->erase(s, ops[i].key))
+      {
+        live--;
+      }
+      break;
+    default:
+      hits += impl->find(s, ops[i].key);
+      break;
+    }
+    if (sampled)
+    {
+      const uint64_t d = now_ns() - s0;
+      samples[nsamples++] = d > overhead ? d - overhead : 0;
+    }
+  }
+  const uint64_t run_ns = now_ns() - t0;
+  sink = hits;
+
+  qsort(samples, nsamples, sizeof(uint64_t), u64_compare);
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  printf("{\"impl\":\"%s\",\"dist\":\"%s\",\"workload\":\"%s\",\"n\":%zu,\"ops\":%zu,\"final_n\":%ld,"
+         "\"build_ns_per_key\":%.1f,\"mops\":%.3f,\"ns_mean\":%.1f,\"ns_p50\":%llu,\"ns_p90\":%llu,"
+         "\"ns_p99\":%llu,\"ns_p999\":%llu,\"ns_max\":%llu,\"find_hits\":%zu,\"peak_rss_kb\":%ld}\n",
+         impl->name, dist, w->name, n, nops, live, n > 0 ? (double)build_ns / (double)n : 0.0,
+         run_ns > 0 ? (double)nops * 1e3 / (double)run_ns : 0.0, nops > 0 ? (double)run_ns / (double)nops : 0.0,
+         (unsigned long long)percentile(samples, nsamples, 0.50),
+         (unsigned long long)percentile(samples, nsamples, 0.90),
+         (unsigned long long)percentile(samples, nsamples, 0.99),
+         (unsigned long long)percentile(samples, nsamples, 0.999),
+         (unsigned long long)(nsamples > 0 ? samples[nsamples - 1] : 0), hits, ru.ru_maxrss);
+  fflush(stdout);
+
+  impl->destroy(s);
+  free(samples);
+  free(ops);
+  return 0;
+}
+
+// ---- command line ----
+
+static size_t split_list(char *arg, char **out)
+{
+  size_t k = 0;
+  for (char *tok = strtok(arg, ","); tok != NULL && k < MAX_LIST; tok = strtok(NULL, ","))
+  {
+    out[k++] = tok;
+  }
+  return k;
+}
+
+static int selected(char **names, const size_t k, const char *name)
+{
+  if (k == 0)
+  {
+    return 1;
+  }
+  for (size_t i = 0; i < k; i++)
+  {
+    if (strcmp(names[i], name) == 0)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [-n sizes] [-o ops] [-i impls] [-d dists] [-w workloads] [-s seed]\n"
+          "  -n  comma separated tree sizes (default 1000,100000,1000000)\n"
+          "  -o  operations per run after the prefill (default 1000000)\n"
+          "  -i  rbtree,rbtree_pool,crbtree,lrbtree,brbtree,std_multiset,sorted_array,rbtree_frozen (default all)\n"
+          "  -d  sequential,uniform,zipf (default all)\n"
+          "  -w  insert-heavy,erase-heavy,find-heavy,find-only (default all)\n"
+          "  read-only implementations (sorted_array, rbtree_frozen) only run find-only\n",
+          prog);
+}
+
+int main(int argc, char **argv)
+{
+  char default_sizes[] = "1000,100000,1000000";
+  char *size_arg = default_sizes;
+  size_t nops = 1000000;
+  uint64_t seed = 0;
+  char *impl_names[MAX_LIST], *dist_names[MAX_LIST], *workload_names[MAX_LIST];
+  size_t nimpl = 0, ndist = 0, nworkload = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:o:i:d:w:s:h")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      size_arg = optarg;
+      break;
+    case 'o':
+      nops = strtoull(optarg, NULL, 10);
+      break;
+    case 'i':
+      nimpl = split_list(optarg, impl_names);
+      break;
+    case 'd':
+      ndist = split_list(optarg, dist_names);
+      break;
+    case 'w':
+      nworkload = split_list(optarg, workload_names);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  char *size_names[MAX_LIST];
+  const size_t nsizes = split_list(size_arg, size_names);
+  int failed = 0;
+  for (size_t si = 0; si < nsizes; si++)
+  {
+    const size_t n = strtoull(size_names[si], NULL, 10);
+    for (size_t wi = 0; wi < sizeof(workloads) / sizeof(workloads[0]); wi++)
+    {
+      const bench_workload *w = &workloads[wi];
+      for (size_t di = 0; di < sizeof(dists) / sizeof(dists[0]); di++)
+      {
+        for (size_t ii = 0; ii < sizeof(impls) / sizeof(impls[0]); ii++)
+        {
+          const bench_impl *impl = &impls[ii];
+          if (!selected(workload_names, nworkload, w->name) || !selected(dist_names, ndist, dists[di]) ||
+              !selected(impl_names, nimpl, impl->name) ||
+              (impl->insert == NULL && (w->insert_pct > 0 || w->erase_pct > 0)))
+          {
+            continue;
+          }
+          const pid_t pid = fork();
+          if (pid == 0)
+          {
+            exit(run_one(impl, dists[di], w, n, nops, seed));
+          }
+          int status;
+          waitpid(pid, &status, 0);
+          if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+          {
+            fprintf(stderr, "%s/%s/%s/%zu failed\n", impl->name, dists[di], w->name, n);
+            failed = 1;
+          }
+        }
+      }
+    }
+  }
+  return failed;
+}
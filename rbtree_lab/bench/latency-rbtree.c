@@ -0,0 +1,248 @@
+#include <getopt.h>
+#include <rbtree.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Per-operation latency of rbtree, for setting SLOs rather than comparing
+// throughput. Every operation is timed on its own and lands in a log-bucketed
+// histogram for its kind; the tree is built with -DRBTREE_STATS so the fixup
+// loops and rotations each operation caused are read off the counters around
+// it. Insert and erase alternate, so the tree stays at the requested size, and
+// delete_rbtree of the whole tree is timed once at the end. One JSON object is
+// printed per operation kind and size.
+#define SUB_BITS 3  // 8 sub-buckets per power of two, about 12% resolution
+#define NBUCKETS (64 << SUB_BITS)
+#define MAX_LIST 32
+
+typedef struct
+{
+  uint64_t buckets[NBUCKETS];
+  uint64_t count, total_ns, max_ns;
+  uint64_t fixup_total, fixup_max;  // fixup loop iterations per operation
+  uint64_t rotations_max;
+} histogram;
+
+enum
+{
+  OP_INSERT,
+  OP_FIND,
+  OP_ERASE,
+  NOPS
+};
+
+static const char *op_names[NOPS] = {"insert", "find", "erase"};
+
+// ---- histogram ----
+
+// bucket of a value: its power of two, then the next SUB_BITS bits below the top one
+static size_t bucket_of(const uint64_t v)
+{
+  if (v < (1u << SUB_BITS))
+  {
+    return (size_t)v;
+  }
+  const int top = 63 - __builtin_clzll(v);
+  const uint64_t sub = (v >> (top - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+  return ((size_t)(top - SUB_BITS + 1) << SUB_BITS) + (size_t)sub;
+}
+
+// largest value that falls into bucket b
+static uint64_t bucket_top(const size_t b)
+{
+  if (b < (1u << SUB_BITS))
+  {
+    return b;
+  }
+  const int top = (int)(b >> SUB_BITS) + SUB_BITS - 1;
+  const uint64_t sub = b & ((1u << SUB_BITS) - 1);
+  return (((1ULL << SUB_BITS) | sub) << (top - SUB_BITS)) + (1ULL << (top - SUB_BITS)) - 1;
+}
+
+static void record(histogram *h, const uint64_t ns, const uint64_t fixups, const uint64_t rotations)
+{
+  h->buckets[bucket_of(ns)]++;
+  h->count++;
+  h->total_ns += ns;
+  h->max_ns = ns > h->max_ns ? ns : h->max_ns;
+  h->fixup_total += fixups;
+  h->fixup_max = fixups > h->fixup_max ? fixups : h->fixup_max;
+  h->rotations_max = rotations > h->rotations_max ? rotations : h->rotations_max;
+}
+
+// upper edge of the bucket holding the q-th quantile, capped at the exact max
+static uint64_t quantile(const histogram *h, const double q)
+{
+  const uint64_t rank = (uint64_t)(q * (double)h->count);
+  uint64_t seen = 0;
+  for (size_t b = 0; b < NBUCKETS; b++)
+  {
+    seen += h->buckets[b];
+    if (seen > rank)
+    {
+      const uint64_t top = bucket_top(b);
+      return top < h->max_ns ? top : h->max_ns;
+    }
+  }
+  return h->max_ns;
+}
+
+// ---- measurement ----
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t rng_next(void)
+{
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// cost of the clock_gettime pair around one op, subtracted from every sample
+static uint64_t timer_overhead(void)
+{
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < 1000; i++)
+  {
+    const uint64_t t0 = now_ns();
+    const uint64_t d = now_ns() - t0;
+    best = d < best ? d : best;
+  }
+  return best;
+}
+
+static volatile size_t sink;  // keeps find results alive
+
+static void run_size(const size_t n, const size_t nops)
+{
+  const uint64_t space = (2 * (uint64_t)n < (uint64_t)INT32_MAX) ? 2 * (uint64_t)n + 1 : (uint64_t)INT32_MAX;
+  key_t *live = malloc((n + 1) * sizeof(key_t));  // keys in the tree, for picking erase targets
+  histogram *h = calloc(NOPS, sizeof(histogram));
+
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++)
+  {
+    live[i] = (key_t)(rng_next() % space);
+    rbtree_insert(t, live[i]);
+  }
+
+  const uint64_t overhead = timer_overhead();
+  size_t hits = 0;
+  for (size_t i = 0; i < nops; i++)
+  {
+    // insert, find, erase of a key that is present, in turn
+    const int op = (int)(i % NOPS);
+    const size_t victim = (size_t)(rng_next() % (n + 1));  // live[0..n] after the insert before it
+    const key_t key = (op == OP_ERASE) ? live[victim] : (key_t)(rng_next() % space);
+    const size_t fixups0 = t->stats.insert_fixup_loops + t->stats.delete_fixup_loops;
+    const size_t rotations0 = t->stats.rotations;
+
+    const uint64_t t0 = now_ns();
+    switch (op)
+    {
+    case OP_INSERT:
+      rbtree_insert(t, key);
+      break;
+    case OP_FIND:
+      hits += rbtree_find(t, key) != NULL;
+      break;
+    default:
+      rbtree_erase(t, rbtree_find(t, key));
+      break;
+    }
+    const uint64_t d = now_ns() - t0;
+
+    record(&h[op], d > overhead ? d - overhead : 0,
+           t->stats.insert_fixup_loops + t->stats.delete_fixup_loops - fixups0, t->stats.rotations - rotations0);
+    if (op == OP_INSERT)
+    {
+      live[n] = key;  // the slot the next erase may pick
+    }
+    else if (op == OP_ERASE)
+    {
+      live[victim] = live[n];  // live[0..n) is the tree again
+    }
+  }
+  sink = hits;
+
+  for (int op = 0; op < NOPS; op++)
+  {
+    const histogram *o = &h[op];
+    printf("{\"n\":%zu,\"op\":\"%s\",\"count\":%llu,\"ns_mean\":%.1f,\"ns_p50\":%llu,\"ns_p99\":%llu,"
+           "\"ns_p999\":%llu,\"ns_max\":%llu,\"fixup_mean\":%.3f,\"fixup_max\":%llu,\"rotations_max\":%llu}\n",
+           n, op_names[op], (unsigned long long)o->count,
+           o->count > 0 ? (double)o->total_ns / (double)o->count : 0.0, (unsigned long long)quantile(o, 0.50),
+           (unsigned long long)quantile(o, 0.99), (unsigned long long)quantile(o, 0.999),
+           (unsigned long long)o->max_ns, o->count > 0 ? (double)o->fixup_total / (double)o->count : 0.0,
+           (unsigned long long)o->fixup_max, (unsigned long long)o->rotations_max);
+  }
+
+  // tearing down a big tree is one long stall for whichever thread does it
+  const size_t count = rbtree_size(t);
+  const uint64_t t0 = now_ns();
+  delete_rbtree(t);
+  const uint64_t d = now_ns() - t0;
+  printf("{\"n\":%zu,\"op\":\"delete_rbtree\",\"count\":1,\"keys\":%zu,\"ns\":%llu,\"ns_per_key\":%.1f}\n", n, count,
+         (unsigned long long)d, count > 0 ? (double)d / (double)count : 0.0);
+  fflush(stdout);
+
+  free(h);
+  free(live);
+}
+
+// ---- command line ----
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [-n sizes] [-o ops] [-s seed]\n"
+          "  -n  comma separated tree sizes (default 1000,100000,1000000)\n"
+          "  -o  operations per size, split evenly over insert/find/erase (default 3000000)\n"
+          "  percentiles are bucket upper edges (about 12%% resolution); max is exact\n",
+          prog);
+}
+
+int main(int argc, char **argv)
+{
+  char default_sizes[] = "1000,100000,1000000";
+  char *size_arg = default_sizes;
+  size_t nops = 3000000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:o:s:h")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      size_arg = optarg;
+      break;
+    case 'o':
+      nops = strtoull(optarg, NULL, 10);
+      break;
+    case 's':
+      rng_state = strtoull(optarg, NULL, 10) | 1;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  size_t k = 0;
+  for (char *tok = strtok(size_arg, ","); tok != NULL && k < MAX_LIST; tok = strtok(NULL, ","), k++)
+  {
+    run_size(strtoull(tok, NULL, 10), nops);
+  }
+  return 0;
+}
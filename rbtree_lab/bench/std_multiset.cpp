@@ -0,0 +1,39 @@
+#include "std_multiset.h"
+
+#include <set>
+
+typedef std::multiset<key_t> key_multiset;
+
+void *std_multiset_create(void)
+{
+  return new key_multiset();
+}
+
+void std_multiset_destroy(void *s)
+{
+  delete static_cast<key_multiset *>(s);
+}
+
+void std_multiset_insert(void *s, key_t key)
+{
+  static_cast<key_multiset *>(s)->insert(key);
+}
+
+int std_multiset_find(void *s, key_t key)
+{
+  key_multiset *set = static_cast<key_multiset *>(s);
+  return set->find(key) != set->end();
+}
+
+// erase one copy of key, like rbtree_erase(t, rbtree_find(t, key))
+int std_multiset_erase(void *s, key_t key)
+{
+  key_multiset *set = static_cast<key_multiset *>(s);
+  key_multiset::iterator it = set->find(key);
+  if (it == set->end())
+  {
+    return 0;
+  }
+  set->erase(it);
+  return 1;
+}
@@ -0,0 +1,22 @@
+#ifndef _STD_MULTISET_H_
+#define _STD_MULTISET_H_
+
+#include <rbtree.h>
+
+// C wrapper around std::multiset<key_t>, the red-black tree shipped with
+// libstdc++, used as the reference point for the benchmarks.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *std_multiset_create(void);
+void std_multiset_destroy(void *);
+void std_multiset_insert(void *, key_t);
+int std_multiset_find(void *, key_t);
+int std_multiset_erase(void *, key_t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _STD_MULTISET_H_
@@ -0,0 +1,400 @@
+#include "crbtree.h"
+
+#include <stdlib.h>
+
+// 노드 한 개 = key 4바이트 + 인덱스 3개 (색은 parent 인덱스의 최하위 비트)
+// 색 비트가 0이면 BLACK이므로, 0으로 초기화된 nil(0번 노드)은 자동으로 BLACK이 된다.
+#define CRB_RED 1u
+
+#define NODE(t, i) ((t)->nodes[(i)])
+
+static inline crb_index parent_of(const crbtree *t, const crb_index i) {
+  return NODE(t, i).parent_color >> 1;
+}
+
+static inline int is_red(const crbtree *t, const crb_index i) {
+  return NODE(t, i).parent_color & CRB_RED;
+}
+
+static inline void set_parent(crbtree *t, const crb_index i, const crb_index p) {
+  NODE(t, i).parent_color = (p << 1) | (NODE(t, i).parent_color & CRB_RED);
+}
+
+static inline void set_red(crbtree *t, const crb_index i) {
+  NODE(t, i).parent_color |= CRB_RED;
+}
+
+static inline void set_black(crbtree *t, const crb_index i) {
+  NODE(t, i).parent_color &= ~CRB_RED;
+}
+
+// 색 비트만 from 노드의 것으로 복사
+static inline void copy_color(crbtree *t, const crb_index to, const crb_index from) {
+  NODE(t, to).parent_color = (NODE(t, to).parent_color & ~CRB_RED) | (NODE(t, from).parent_color & CRB_RED);
+}
+
+// 노드 슬롯 하나를 할당하는 함수 (free list 우선, 없으면 pool 끝에서, 가득 차면 두 배로 확장)
+// 노드끼리는 인덱스로 연결되어 있어 realloc으로 pool이 옮겨가도 그대로 유효하다.
+// 인덱스가 CRB_MAX_SLOTS에 닿으면 parent_color에서 색 비트와 겹치므로 더 늘리지 않고,
+// 더 늘릴 수 없거나 realloc이 실패하면 pool을 그대로 두고 0을 반환한다.
+static crb_index slot_alloc(crbtree *t) {
+  if (t->free_list != 0) {
+    const crb_index i = t->free_list;
+    t->free_list = NODE(t, i).left;
+    return i;
+  }
+  if (t->used == t->capacity) {
+    if (t->capacity >= CRB_MAX_SLOTS) {
+      return 0;
+    }
+    const uint32_t capacity = (t->capacity > CRB_MAX_SLOTS / 2) ? CRB_MAX_SLOTS : t->capacity * 2;
+    crb_node *nodes = (crb_node *)realloc(t->nodes, (size_t)capacity * sizeof(crb_node));
+    if (nodes == NULL) {
+      return 0;
+    }
+    t->nodes = nodes;
+    t->capacity = capacity;
+  }
+  return t->used++;
+}
+
+// 노드 슬롯을 free list에 반환하는 함수
+static void slot_free(crbtree *t, const crb_index i) {
+  NODE(t, i).left = t->free_list;
+  t->free_list = i;
+}
+
+static void transplant(crbtree *t, const crb_index u, const crb_index v) {
+  const crb_index up = parent_of(t, u);
+  if (up == 0) {
+    t->root = v;
+  } else if (u == NODE(t, up).left) {
+    NODE(t, up).left = v;
+  } else {
+    NODE(t, up).right = v;
+  }
+  set_parent(t, v, up);
+}
+
+static void left_rotate(crbtree *t, const crb_index x) {
+  const crb_index y = NODE(t, x).right;
+  const crb_index xp = parent_of(t, x);
+
+  NODE(t, x).right = NODE(t, y).left;
+  if (NODE(t, y).left != 0) {
+    set_parent(t, NODE(t, y).left, x);
+  }
+
+  set_parent(t, y, xp);
+  if (xp == 0) {
+    t->root = y;
+  } else if (x == NODE(t, xp).left) {
+    NODE(t, xp).left = y;
+  } else {
+    NODE(t, xp).right = y;
+  }
+
+  NODE(t, y).left = x;
+  set_parent(t, x, y);
+}
+
+static void right_rotate(crbtree *t, const crb_index x) {
+  const crb_index y = NODE(t, x).left;
+  const crb_index xp = parent_of(t, x);
+
+  NODE(t, x).left = NODE(t, y).right;
+  if (NODE(t, y).right != 0) {
+    set_parent(t, NODE(t, y).right, x);
+  }
+
+  set_parent(t, y, xp);
+  if (xp == 0) {
+    t->root = y;
+  } else if (x == NODE(t, xp).right) {
+    NODE(t, xp).right = y;
+  } else {
+    NODE(t, xp).left = y;
+  }
+
+  NODE(t, y).right = x;
+  set_parent(t, x, y);
+}
+
+// rbtree.c의 rbtree_insert_fixup과 같은 경우 분류를 인덱스로 수행
+static void crbtree_insert_fixup(crbtree *t, crb_index z) {
+  while (is_red(t, parent_of(t, z))) {
+    const crb_index zp = parent_of(t, z);
+    const crb_index zpp = parent_of(t, zp);
+
+    if (zp == NODE(t, zpp).left) {
+      const crb_index uncle = NODE(t, zpp).right;
+      if (is_red(t, uncle)) {  // 삼촌이 RED : 색 변경 후 조부모로 이동
+        set_black(t, zp);
+        set_black(t, uncle);
+        set_red(t, zpp);
+        z = zpp;
+      } else {
+        if (z == NODE(t, zp).right) {  // 꺾인 모양 : 직선 모양으로 변환
+          z = zp;
+          left_rotate(t, z);
+        }
+        set_black(t, parent_of(t, z));
+        set_red(t, parent_of(t, parent_of(t, z)));
+        right_rotate(t, parent_of(t, parent_of(t, z)));
+      }
+    } else {  // 대칭
+      const crb_index uncle = NODE(t, zpp).left;
+      if (is_red(t, uncle)) {
+        set_black(t, zp);
+        set_black(t, uncle);
+        set_red(t, zpp);
+        z = zpp;
+      } else {
+        if (z == NODE(t, zp).left) {
+          z = zp;
+          right_rotate(t, z);
+        }
+        set_black(t, parent_of(t, z));
+        set_red(t, parent_of(t, parent_of(t, z)));
+        left_rotate(t, parent_of(t, parent_of(t, z)));
+      }
+    }
+  }
+  set_black(t, t->root);
+}
+
+// rbtree.c의 rbtree_delete_fixup과 같은 경우 분류를 인덱스로 수행
+static void crbtree_delete_fixup(crbtree *t, crb_index x) {
+  while (x != t->root && !is_red(t, x)) {
+    const crb_index xp = parent_of(t, x);
+
+    if (x == NODE(t, xp).left) {
+      crb_index w = NODE(t, xp).right;  // 형제 노드
+
+      if (is_red(t, w)) {  // Case 1
+        set_black(t, w);
+        set_red(t, xp);
+        left_rotate(t, xp);
+        w = NODE(t, xp).right;
+      }
+      if (!is_red(t, NODE(t, w).left) && !is_red(t, NODE(t, w).right)) {  // Case 2
+        set_red(t, w);
+        x = xp;
+      } else {
+        if (!is_red(t, NODE(t, w).right)) {  // Case 3
+          set_black(t, NODE(t, w).left);
+          set_red(t, w);
+          right_rotate(t, w);
+          w = NODE(t, xp).right;
+        }
+        copy_color(t, w, xp);  // Case 4
+        set_black(t, xp);
+        set_black(t, NODE(t, w).right);
+        left_rotate(t, xp);
+        x = t->root;
+      }
+    } else {  // 대칭
+      crb_index w = NODE(t, xp).left;
+
+      if (is_red(t, w)) {
+        set_black(t, w);
+        set_red(t, xp);
+        right_rotate(t, xp);
+        w = NODE(t, xp).left;
+      }
+      if (!is_red(t, NODE(t, w).right) && !is_red(t, NODE(t, w).left)) {
+        set_red(t, w);
+        x = xp;
+      } else {
+        if (!is_red(t, NODE(t, w).left)) {
+          set_black(t, NODE(t, w).right);
+          set_red(t, w);
+          left_rotate(t, w);
+          w = NODE(t, xp).left;
+        }
+        copy_color(t, w, xp);
+        set_black(t, xp);
+        set_black(t, NODE(t, w).left);
+        right_rotate(t, xp);
+        x = t->root;
+      }
+    }
+  }
+  set_black(t, x);
+}
+
+// 빈 compact 트리를 생성하는 함수 (0번 슬롯은 nil)
+crbtree *new_crbtree(void) {
+  crbtree *t = (crbtree *)calloc(1, sizeof(crbtree));
+  t->capacity = 64;
+  t->nodes = (crb_node *)calloc(t->capacity, sizeof(crb_node));
+  t->used = 1;  // nil 자리
+  return t;
+}
+
+// 노드들이 하나의 배열에 있으므로 순회 없이 배열만 해제
+void delete_crbtree(crbtree *t) {
+  free(t->nodes);
+  free(t);
+}
+
+crb_index crbtree_insert(crbtree *t, const key_t key) {
+  crb_index y = 0;
+  crb_index x = t->root;
+
+  while (x != 0) {  // 삽입할 위치 탐색 (같은 key는 오른쪽으로)
+    y = x;
+    x = (key < NODE(t, x).key) ? NODE(t, x).left : NODE(t, x).right;
+  }
+
+  // slot_alloc이 pool을 옮길 수 있으므로 노드 접근은 할당 이후에만 한다.
+  const crb_index z = slot_alloc(t);
+  if (z == 0) {
+    return 0;
+  }
+  NODE(t, z).key = key;
+  NODE(t, z).left = 0;
+  NODE(t, z).right = 0;
+  NODE(t, z).parent_color = (y << 1) | CRB_RED;  // 새 노드는 RED
+
+  if (y == 0) {
+    t->root = z;
+  } else if (key < NODE(t, y).key) {
+    NODE(t, y).left = z;
+  } else {
+    NODE(t, y).right = z;
+  }
+
+  crbtree_insert_fixup(t, z);
+  t->count++;
+  return z;
+}
+
+// key와 같은 노드의 인덱스를 반환, 없으면 0
+crb_index crbtree_find(const crbtree *t, const key_t key) {
+  const crb_node *nodes = t->nodes;
+  crb_index x = t->root;
+
+  while (x != 0) {
+    if (nodes[x].key == key) {
+      return x;
+    }
+    x = (nodes[x].key > key) ? nodes[x].left : nodes[x].right;
+  }
+  return 0;
+}
+
+crb_index crbtree_min(const crbtree *t) {
+  crb_index x = t->root;
+  if (x == 0) {
+    return 0;
+  }
+  while (NODE(t, x).left != 0) {
+    x = NODE(t, x).left;
+  }
+  return x;
+}
+
+crb_index crbtree_max(const crbtree *t) {
+  crb_index x = t->root;
+  if (x == 0) {
+    return 0;
+  }
+  while (NODE(t, x).right != 0) {
+    x = NODE(t, x).right;
+  }
+  return x;
+}
+
+int crbtree_erase(crbtree *t, const crb_index p) {
+  crb_index y = p;
+  crb_index x;
+  int y_was_red = is_red(t, y);
+
+  if (NODE(t, p).left == 0) {
+    x = NODE(t, p).right;
+    transplant(t, p, x);
+  } else if (NODE(t, p).right == 0) {
+    x = NODE(t, p).left;
+    transplant(t, p, x);
+  } else {
+    y = NODE(t, p).right;  // successor
+    while (NODE(t, y).left != 0) {
+      y = NODE(t, y).left;
+    }
+    y_was_red = is_red(t, y);
+    x = NODE(t, y).right;
+
+    if (parent_of(t, y) == p) {
+      set_parent(t, x, y);  // x가 nil이어도 fixup이 부모를 알 수 있도록 설정
+    } else {
+      transplant(t, y, NODE(t, y).right);
+      NODE(t, y).right = NODE(t, p).right;
+      set_parent(t, NODE(t, y).right, y);
+    }
+    transplant(t, p, y);
+    NODE(t, y).left = NODE(t, p).left;
+    set_parent(t, NODE(t, y).left, y);
+    copy_color(t, y, p);
+  }
+
+  if (!y_was_red) {
+    crbtree_delete_fixup(t, x);
+  }
+
+  slot_free(t, p);
+  t->count--;
+  return 0;
+}
+
+// 중위 순서상 다음 노드의 인덱스, 없으면 0
+crb_index crbtree_next(const crbtree *t, crb_index x) {
+  if (x == 0) {
+    return 0;
+  }
+  if (NODE(t, x).right != 0) {
+    x = NODE(t, x).right;
+    while (NODE(t, x).left != 0) {
+      x = NODE(t, x).left;
+    }
+    return x;
+  }
+  crb_index y = parent_of(t, x);
+  while (y != 0 && x == NODE(t, y).right) {
+    x = y;
+    y = parent_of(t, y);
+  }
+  return y;
+}
+
+// 중위 순서상 이전 노드의 인덱스, 없으면 0
+crb_index crbtree_prev(const crbtree *t, crb_index x) {
+  if (x == 0) {
+    return 0;
+  }
+  if (NODE(t, x).left != 0) {
+    x = NODE(t, x).left;
+    while (NODE(t, x).right != 0) {
+      x = NODE(t, x).right;
+    }
+    return x;
+  }
+  crb_index y = parent_of(t, x);
+  while (y != 0 && x == NODE(t, y).left) {
+    x = y;
+    y = parent_of(t, y);
+  }
+  return y;
+}
+
+size_t crbtree_size(const crbtree *t) {
+  return t->count;
+}
+
+int crbtree_to_array(const crbtree *t, key_t *arr, const size_t n) {
+  size_t idx = 0;
+  for (crb_index x = crbtree_min(t); x != 0 && idx < n; x = crbtree_next(t, x)) {
+    arr[idx++] = NODE(t, x).key;
+  }
+  return 0;
+}
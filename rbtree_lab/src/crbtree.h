@@ -0,0 +1,52 @@
+#ifndef _CRBTREE_H_
+#define _CRBTREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// Compact red-black tree: nodes live in one contiguous pool and refer to
+// each other by 32-bit index, with the color packed into the low bit of the
+// parent index. Index 0 is the nil sentinel, so 0 also means "not found".
+// Holds up to 2^31 - 1 keys: an index has to leave the top bit free for the
+// color shift, so the pool never grows past CRB_MAX_SLOTS slots.
+typedef uint32_t crb_index;
+
+#define CRB_MAX_SLOTS ((uint32_t)1 << 31)  // including the nil slot
+
+typedef struct {
+  key_t key;
+  crb_index left, right;
+  uint32_t parent_color;  // parent index << 1 | 1 if red
+} crb_node;               // 16 bytes
+
+typedef struct {
+  crb_node *nodes;     // nodes[0] is the nil sentinel
+  crb_index root;
+  uint32_t capacity;   // slots allocated in nodes
+  uint32_t used;       // slots handed out so far (including nil)
+  crb_index free_list; // erased slots, linked through left
+  size_t count;
+} crbtree;
+
+crbtree *new_crbtree(void);
+void delete_crbtree(crbtree *);
+
+// index of the new node, 0 if the tree is full or out of memory (tree unchanged)
+crb_index crbtree_insert(crbtree *, const key_t);
+crb_index crbtree_find(const crbtree *, const key_t);
+crb_index crbtree_min(const crbtree *);
+crb_index crbtree_max(const crbtree *);
+int crbtree_erase(crbtree *, crb_index);
+
+crb_index crbtree_next(const crbtree *, crb_index);
+crb_index crbtree_prev(const crbtree *, crb_index);
+size_t crbtree_size(const crbtree *);
+int crbtree_to_array(const crbtree *, key_t *, const size_t);
+
+static inline key_t crbtree_key(const crbtree *t, const crb_index i) {
+  return t->nodes[i].key;
+}
+
+#endif  // _CRBTREE_H_
@@ -1,22 +1,391 @@
 #include "rbtree.h"
 
+#include <limits.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+// rbtree_from_sorted가 만든 트리가 이후 삽입에 쓰는 pool chunk 크기 (처음 노드들은 따로 한 덩어리로 할당)
+#define RBTREE_POOL_CHUNK 1024
+// 이보다 큰 배치 정렬과 배열 내보내기만 여러 스레드로 나누어 처리
+#define BATCH_PARALLEL_MIN (1 << 16)
+// 배치 정렬과 배열 내보내기에 쓰는 최대 스레드 수
+#define BATCH_MAX_THREADS 8
+// rbtree_insert_many : 배치가 이보다 작으면 하나씩 삽입
+#define INSERT_MANY_SINGLE_MAX 64
+// rbtree_insert_many : 배치가 트리의 1/INSERT_MANY_REBUILD_RATIO 이상이면 전체를 O(n + m)에 다시 연결, 작으면 union
+#define INSERT_MANY_REBUILD_RATIO 4
+// red-black tree의 높이는 2*log2(n+1) 이하이므로 size_t 범위의 어떤 트리도 이보다 높을 수 없음
+#define RBTREE_MAX_HEIGHT 128
 
-static void recursion_delete_tree(node_t *t, node_t *nil) {
-  // 현재 노드가 nil노드이면 더 이상 진행하지 않고 종료
-  if (t == nil) {
+#ifdef RBTREE_STATS
+// 통계 카운터를 더하는 매크로 (rbtree_find는 여러 스레드에서 동시에 부를 수 있으므로 relaxed atomic)
+#define STAT_ADD(t, field, n) __atomic_fetch_add(&((rbtree *)(t))->stats.field, (n), __ATOMIC_RELAXED)
+#define STAT_FIND(t, depth) \
+  STAT_ADD(t, find_depth[(depth) < RBTREE_DEPTH_BUCKETS ? (depth) : RBTREE_DEPTH_BUCKETS - 1], 1)
+#else
+// -DRBTREE_STATS 없이 빌드하면 아무 코드도 만들지 않음
+#define STAT_ADD(t, field, n) ((void)0)
+#define STAT_FIND(t, depth) ((void)(depth))
+#endif
+
+// 모든 트리가 함께 쓰는 nil(센티넬) 노드
+// 어떤 연산도 nil에 쓰지 않으므로 읽기 전용 영역에 두며, 덕분에 트리 사이에서
+// 서브트리를 nil 포인터 수정 없이 그대로 옮길 수 있다 (rbtree_join/rbtree_split).
+static const node_t rbtree_nil = {
+    .color = RBTREE_BLACK,
+    .parent = (node_t *)&rbtree_nil,
+    .left = (node_t *)&rbtree_nil,
+    .right = (node_t *)&rbtree_nil,
+#ifdef RBTREE_INTERVAL
+    .max_hi = INT_MIN,  // 빈 서브트리는 어떤 구간과도 겹치지 않음
+#endif
+};
+
+// slab chunk : 노드 chunk_nodes개를 연속된 메모리에 담는 블록
+// chunk 목록은 앞에만 붙이고 고치지 않으므로, rbtree_split으로 나뉜 두 pool이 같은 뒷부분을 함께 가리킬 수 있다.
+typedef struct pool_chunk {
+  struct pool_chunk *next;  // 이전에 할당한 chunk (chunk 목록)
+  size_t refs;              // 이 chunk를 가리키는 pool과 chunk의 수 (여러 스레드에서 해제할 수 있으므로 atomic)
+  node_t nodes[];           // 노드 저장 공간
+} pool_chunk;
+
+// bump 할당에 쓰지 않는 chunk 목록 (pool_reserve 덩어리, 흡수한 pool의 chunk 목록)
+typedef struct chunk_list {
+  pool_chunk *head;
+  struct chunk_list *next;
+} chunk_list;
+
+// 트리 하나가 소유하는 노드 전용 slab allocator
+struct rbtree_pool {
+  pool_chunk *chunks;   // 할당한 chunk들의 목록 (가장 최근 chunk가 맨 앞)
+  chunk_list *extra;    // 그 밖에 이 pool이 붙잡고 있는 chunk 목록들
+  size_t chunk_nodes;   // chunk 하나에 들어가는 노드 수
+  size_t used;          // 가장 최근 chunk에서 이미 나눠준 노드 수
+  node_t *free_list;    // 반환된 노드들의 intrusive free list (right 포인터로 연결)
+  size_t refs;          // 이 pool을 함께 쓰는 트리 수 (join이나 집합 연산으로 비워진 트리가 함께 씀)
+  size_t bytes;         // 이 pool이 할당한 chunk들의 전체 크기 (나뉘기 전 pool의 chunk는 원래 pool에서 셈)
+  node_t *bulk;         // pool_reserve로 한꺼번에 잡아둔 노드 중 아직 나눠주지 않은 첫 노드
+  size_t bulk_left;     // bulk에 남은 노드 수
+};
+
+static rbtree_pool *pool_create(const size_t chunk_nodes) {
+  rbtree_pool *pool = (rbtree_pool *)malloc(sizeof *pool);
+  pool->chunks = NULL;
+  pool->extra = NULL;
+  pool->chunk_nodes = chunk_nodes;
+  pool->used = chunk_nodes;  // 첫 할당 때 chunk를 새로 만들도록 가득 찬 것으로 시작
+  pool->free_list = NULL;
+  pool->refs = 1;
+  pool->bytes = 0;
+  pool->bulk = NULL;
+  pool->bulk_left = 0;
+  return pool;
+}
+
+// chunk 목록 head를 가리키던 참조 하나를 놓는 함수, 아무도 가리키지 않게 된 chunk부터 차례로 해제
+static void chunk_release(pool_chunk *c) {
+  while (c != NULL && __atomic_sub_fetch(&c->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    pool_chunk *next = c->next;
+    free(c);
+    c = next;
+  }
+}
+
+static void chunk_retain(pool_chunk *c) {
+  if (c != NULL) {
+    __atomic_add_fetch(&c->refs, 1, __ATOMIC_RELAXED);
+  }
+}
+
+// head로 시작하는 chunk 목록을 pool의 extra 목록에 추가 (head의 참조는 pool이 넘겨받음)
+static void pool_hold(rbtree_pool *pool, pool_chunk *head) {
+  chunk_list *l = (chunk_list *)malloc(sizeof *l);
+  l->head = head;
+  l->next = pool->extra;
+  pool->extra = l;
+}
+
+// 노드 n개를 한 덩어리로 할당해 다음 할당들이 차례로 가져가게 하는 함수 (rbtree_from_sorted)
+// chunk_nodes는 그대로 두므로 덩어리를 다 쓴 뒤의 삽입은 보통 크기의 chunk를 붙인다.
+// 덩어리는 bump 할당 중인 chunk 목록과 따로 extra 목록에 두고 해제할 때만 함께 다룬다.
+static void pool_reserve(rbtree_pool *pool, const size_t n) {
+  if (n == 0) {
     return;
   }
+  const size_t bytes = sizeof(pool_chunk) + n * sizeof(node_t);
+  pool_chunk *c = (pool_chunk *)malloc(bytes);
+  pool->bytes += bytes;
+  c->next = NULL;
+  c->refs = 1;
+  pool_hold(pool, c);
+  pool->bulk = c->nodes;
+  pool->bulk_left = n;
+}
 
-  // 왼쪽 자식 노드로 재귀 호출
-  recursion_delete_tree(t->left, nil);
+static void pool_destroy(rbtree_pool *pool) {
+  // 노드를 하나씩 해제하지 않고 chunk 단위로 한꺼번에 반환 (다른 pool과 함께 가진 chunk는 남음)
+  chunk_release(pool->chunks);
+  while (pool->extra != NULL) {
+    chunk_list *next = pool->extra->next;
+    chunk_release(pool->extra->head);
+    free(pool->extra);
+    pool->extra = next;
+  }
+  free(pool);
+}
+
+// rbtree_split으로 떼어낸 트리가 쓸 새 pool을 만드는 함수
+// 떼어낸 노드들은 그대로 원래 pool의 chunk에 남으므로 그 chunk 목록들을 함께 붙잡고,
+// 할당 상태(bump 위치, free list)는 따로 가지므로 두 트리를 서로 다른 스레드에서 써도 된다.
+static rbtree_pool *pool_split(rbtree_pool *pool) {
+  rbtree_pool *r = pool_create(pool->chunk_nodes);
+  chunk_retain(pool->chunks);
+  r->chunks = pool->chunks;  // used == chunk_nodes 이므로 r의 첫 bump 할당은 새 chunk를 맨 앞에 만듦
+  for (chunk_list *l = pool->extra; l != NULL; l = l->next) {
+    chunk_retain(l->head);
+    pool_hold(r, l->head);
+  }
+  return r;
+}
 
-  // 오른쪽 자식 노드로 재귀 호출
-  recursion_delete_tree(t->right, nil);
+// pool을 쓰는 트리가 하나 줄었을 때 호출, 마지막 트리였다면 chunk까지 해제
+static void pool_release(rbtree_pool *pool) {
+  if (--pool->refs == 0) {
+    pool_destroy(pool);
+  }
+}
 
-  // 왼쪽과 오른쪽 자식들이 모두 처리된 후, 현재 노드의 메모리를 해제
-  free(t);
+// src pool의 chunk와 free list를 dst pool로 옮기고 src를 해제하는 함수
+// src를 쓰는 트리가 하나뿐일 때만 호출해야 한다.
+static void pool_absorb(rbtree_pool *dst, rbtree_pool *src) {
+  // chunk 목록은 다른 pool과 함께 가리킬 수 있어 이어 붙이지 않고, 목록째 dst의 extra로 넘김
+  if (src->chunks != NULL) {
+    pool_hold(dst, src->chunks);
+  }
+  chunk_list **tail = &dst->extra;
+  while (*tail != NULL) {
+    tail = &(*tail)->next;
+  }
+  *tail = src->extra;
+
+  if (src->free_list != NULL) {
+    node_t *last = src->free_list;
+    while (last->right != NULL) {
+      last = last->right;
+    }
+    last->right = dst->free_list;
+    dst->free_list = src->free_list;
+  }
+  dst->bytes += src->bytes;
+  free(src);
+}
+
+// 노드 하나를 할당하는 함수 (pool이 있으면 malloc을 부르지 않음)
+static node_t *node_alloc(rbtree *t) {
+  rbtree_pool *pool = t->pool;
+  if (pool == NULL) {
+    return (node_t *)malloc(sizeof(node_t));
+  }
+
+  // 반환된 노드가 있으면 먼저 재사용
+  if (pool->free_list != NULL) {
+    node_t *p = pool->free_list;
+    pool->free_list = p->right;
+    return p;
+  }
+
+  // 미리 잡아둔 덩어리가 남아있으면 거기서 가져감
+  if (pool->bulk_left > 0) {
+    pool->bulk_left--;
+    return pool->bulk++;
+  }
+
+  // 현재 chunk를 다 썼다면 새 chunk를 하나 붙임
+  if (pool->used == pool->chunk_nodes) {
+    const size_t bytes = sizeof(pool_chunk) + pool->chunk_nodes * sizeof(node_t);
+    pool_chunk *c = (pool_chunk *)malloc(bytes);
+    pool->bytes += bytes;
+    c->next = pool->chunks;  // 이전 맨 앞 chunk에 대한 pool의 참조를 c가 넘겨받음
+    c->refs = 1;
+    pool->chunks = c;
+    pool->used = 0;
+  }
+  return &pool->chunks->nodes[pool->used++];
+}
+
+// 노드 하나를 반환하는 함수 (pool이 있으면 free list에 다시 넣음)
+static void node_free(rbtree *t, node_t *p) {
+  rbtree_pool *pool = t->pool;
+  if (pool == NULL) {
+    free(p);
+    return;
+  }
+  p->right = pool->free_list;
+  pool->free_list = p;
+}
+
+
+// 새 노드를 하나 할당해 key를 채우는 함수 (나머지 필드는 연결하는 쪽에서 채움)
+static node_t *node_new(rbtree *t, const key_t key) {
+  node_t *z = node_alloc(t);
+  z->key = key;
+#ifdef RBTREE_COUNTED
+  z->copies = 1;
+#endif
+#ifdef RBTREE_INTERVAL
+  z->hi = z->max_hi = key;  // 구간을 따로 주지 않으면 점 [key, key]
+#endif
+  return z;
+}
+
+// 노드 x가 담고 있는 key의 개수 (RBTREE_COUNTED가 아니면 항상 1, nil은 0)
+static size_t node_copies(const rbtree *t, const node_t *x) {
+#ifdef RBTREE_COUNTED
+  (void)t;
+  return x->copies;
+#else
+  return x != t->nil;
+#endif
+}
+
+
+#ifndef RBTREE_NO_ORDER_STATS
+// x의 서브트리 크기를 두 자식의 크기로부터 다시 계산 (nil의 size는 항상 0)
+static void update_size(node_t *x) {
+#ifdef RBTREE_COUNTED
+  x->size = x->left->size + x->right->size + x->copies;
+#else
+  x->size = x->left->size + x->right->size + 1;
+#endif
+}
+
+// key k개가 빠진 자리의 조상들(w부터 루트까지)의 서브트리 크기를 k씩 줄임
+static void shrink_path(rbtree *t, node_t *w, const size_t k) {
+  while (w != t->nil) {
+    w->size -= k;
+    w = w->parent;
+  }
+}
+
+// key k개가 새로 들어온 자리의 조상들(w부터 루트까지)의 서브트리 크기를 k씩 늘림
+static void grow_path(rbtree *t, node_t *w, const size_t k) {
+  while (w != t->nil) {
+    w->size += k;
+    w = w->parent;
+  }
+}
+#else
+static void update_size(node_t *x) { (void)x; }
+static void shrink_path(rbtree *t, node_t *w, const size_t k) { (void)t; (void)w; (void)k; }
+static void grow_path(rbtree *t, node_t *w, const size_t k) { (void)t; (void)w; (void)k; }
+#endif
+
+#ifdef RBTREE_INTERVAL
+// x의 max_hi를 자기 구간의 끝과 두 자식의 max_hi로부터 다시 계산 (nil의 max_hi는 INT_MIN)
+static void update_max(node_t *x) {
+  key_t m = x->hi;
+  if (x->left->max_hi > m) {
+    m = x->left->max_hi;
+  }
+  if (x->right->max_hi > m) {
+    m = x->right->max_hi;
+  }
+  x->max_hi = m;
+}
+
+// 서브트리가 바뀐 w부터 루트까지 max_hi를 다시 계산
+// 값은 줄어들 수도 있으므로 (삭제) 크기처럼 더하고 빼지 않고 자식들로부터 다시 구한다.
+static void fix_max_path(rbtree *t, node_t *w) {
+  while (w != t->nil) {
+    update_max(w);
+    w = w->parent;
+  }
+}
+#else
+static void update_max(node_t *x) { (void)x; }
+static void fix_max_path(rbtree *t, node_t *w) { (void)t; (void)w; }
+#endif
+
+// 서브트리 x에 들어있는 key 수
+static size_t subtree_count(const rbtree *t, const node_t *x) {
+#ifndef RBTREE_NO_ORDER_STATS
+  (void)t;
+  return x->size;
+#else
+  if (x == t->nil) {
+    return 0;
+  }
+  return subtree_count(t, x->left) + subtree_count(t, x->right) + node_copies(t, x);
+#endif
+}
+
+static void delete_subtree(rbtree *t, node_t *x) {
+  if (x == t->nil) {
+    return;
+  }
+  node_t *const stop = x->parent;  // x의 부모까지 올라오면 끝
+  for (;;) {
+    if (x->left != t->nil) {
+      // 왼쪽을 다 지우면 곧바로 오른쪽 형제로 내려가므로 미리 읽어둠
+      __builtin_prefetch(x->right);
+      x = x->left;
+    } else if (x->right != t->nil) {
+      x = x->right;
+    } else {
+      // 잎 노드 : 부모에서 떼어낸 뒤 해제하고 부모로 올라감
+      node_t *p = x->parent;
+      node_free(t, x);
+      if (p == stop) {
+        return;
+      }
+      if (p->left == x) {
+        p->left = t->nil;
+      } else {
+        p->right = t->nil;
+      }
+      x = p;
+    }
+  }
+}
+
+// 서브트리 x에서 가장 왼쪽 노드, x가 nil이면 nil
+static node_t *subtree_min(const rbtree *t, node_t *x) {
+  if (x != t->nil) {
+    while (x->left != t->nil) {
+      x = x->left;
+    }
+  }
+  return x;
+}
+
+// 서브트리 x에서 가장 오른쪽 노드, x가 nil이면 nil
+static node_t *subtree_max(const rbtree *t, node_t *x) {
+  if (x != t->nil) {
+    while (x->right != t->nil) {
+      x = x->right;
+    }
+  }
+  return x;
+}
+
+// 트리를 통째로 다시 연결한 뒤 (build_tree, join, split, 집합 연산) 양 끝 노드를 루트에서 다시 찾음
+static void reset_ends(rbtree *t) {
+  t->leftmost = subtree_min(t, t->root);
+  t->rightmost = subtree_max(t, t->root);
+}
+
+// 잎으로 새로 붙인 노드 z가 새 최솟값/최댓값인지 확인해 양 끝을 갱신
+// 기존 끝 노드의 바깥쪽 자식으로 붙었거나 빈 트리에 들어갔을 때만 그렇다. (회전은 중위 순서를 바꾸지 않음)
+static void extend_ends(rbtree *t, node_t *z) {
+  node_t *y = z->parent;
+  if (y == t->nil || (y == t->leftmost && y->left == z)) {
+    t->leftmost = z;
+  }
+  if (y == t->nil || (y == t->rightmost && y->right == z)) {
+    t->rightmost = z;
+  }
 }
 
 // 트리에서 노드 u를 노드 v로 교체하는 함수
@@ -31,42 +400,45 @@ static void transplant(rbtree *t, node_t *u, node_t *v){
     u->parent->right = v;
   }
   // v의 부모 포인터를 u의 부모로 연결
-  // (즉, v가 이제 u의 자리를 차지하도록 설정)
-  v->parent = u->parent;
-}
-
-
-// 중위 순회 보조 함수
-// t : RED-BLACK TREE 구조체 (nil 노드 접근을 위해 필요)
-// node : 현재 방문 중인 노드
-// arr : key를 저장할 배열
-// n : 배열의 최대 크기
-// idx : 배열에 키를 저장할 현재 인덱스를 가리키는 포인터 (재귀 호출 간에 상태 유지를 위해 필요)
-static void inorder_traverse(const rbtree *t, node_t *node, key_t *arr, const size_t n, size_t *idx) {
-  // 현재 노드가 nil 노드이거나, 배열이 이미 가득 찼다면 종료
-  if (node == t->nil || *idx >= n) {
-    return;
+  // (즉, v가 이제 u의 자리를 차지하도록 설정, 공유 nil에는 쓰지 않음)
+  if (v != t->nil) {
+    v->parent = u->parent;
   }
+}
 
-  // 왼쪽 서브트리 순회
-  inorder_traverse(t, node->left, arr, n, idx);
 
-  // 현재 노드 처리 (배열에 키 저장)
-  // 배열의 크기를 초과하지 않는지 다시 한번 확인
-  if (*idx < n) {
-    arr[*idx] = node->key;
-    (*idx)++;
-  } else {
-    return; // 배열이 가득 찼으므로 더 이상 저장하지 않음
+// 서브트리 root를 중위 순회하며 key를 arr에 최대 n개 저장하고, 저장한 수를 반환하는 함수
+// 재귀 대신 높이만큼의 고정 크기 배열에 조상들을 쌓는다. (parent 포인터로 올라가면 오래전에 지나온
+// 조상을 다시 읽느라 노드마다 cache miss가 한 번 더 생김)
+// 왼쪽 경로를 내려가며 각 노드의 오른쪽 자식을 미리 읽어두어, 그 노드를 방문할 때의 cache miss가
+// 아래쪽 노드들의 처리와 겹치도록 한다.
+static size_t inorder_traverse(const rbtree *t, node_t *root, key_t *arr, const size_t n) {
+  node_t *stack[RBTREE_MAX_HEIGHT];
+  int top = 0;
+  size_t idx = 0;
+  node_t *x = root;
+  while (idx < n) {
+    while (x != t->nil) {
+      __builtin_prefetch(x->right);
+      stack[top++] = x;
+      x = x->left;
+    }
+    if (top == 0) {
+      break;
+    }
+    x = stack[--top];  // 왼쪽 서브트리를 다 저장했으므로 x 차례
+    for (size_t c = node_copies(t, x); c > 0 && idx < n; c--) {
+      arr[idx++] = x->key;
+    }
+    x = x->right;
   }
-
-  // 오른쪽 서브트리 순회
-  inorder_traverse(t, node->right, arr, n, idx);
-} 
+  return idx;
+}
 
 
 static void left_rotate(rbtree *t, node_t *x) {
   node_t *y = x->right;
+  STAT_ADD(t, rotations, 1);
   x->right = y->left; // y의 왼쪽 서브트리를 x의 오른쪽 서브트리로 회전한다
 
   if (y->left != t->nil) {  // y의 왼쪽 서브트리가 비어있지(nil) 않다면
@@ -86,10 +458,17 @@ static void left_rotate(rbtree *t, node_t *x) {
 
   y->left = x;    // x를 y의 왼쪽 자식이 되게 한다
   x->parent = y;  // x의 부모는 y이다
+
+  // 서브트리가 바뀐 x를 먼저, 그 위의 y를 나중에 다시 계산
+  update_size(x);
+  update_size(y);
+  update_max(x);
+  update_max(y);
 }
 
 static void right_rotate(rbtree *t, node_t *x) {
   node_t *y = x->left;
+  STAT_ADD(t, rotations, 1);
   x->left = y->right; // y의 오른쪽 서브트리를 x의 왼쪽 서브트리로 회전한다
 
   if (y->right != t->nil) { // y의 오른쪽 서브트리가 비어있지(nil) 않다면
@@ -109,10 +488,17 @@ static void right_rotate(rbtree *t, node_t *x) {
 
   y->right = x;   // x를 y의 오른쪽 자식이 되게 하고
   x->parent = y;  // x의 부모는 y이다
+
+  update_size(x);
+  update_size(y);
+  update_max(x);
+  update_max(y);
 }
 
-static void rbtree_insert_fixup(rbtree *t, node_t *z) {
+// 루트가 RED가 되어 BLACK으로 다시 칠했으면(black height가 1 늘었으면) 1 반환
+static int rbtree_insert_fixup(rbtree *t, node_t *z) {
   while (z->parent->color == RBTREE_RED) {
+    STAT_ADD(t, insert_fixup_loops, 1);
     // Case A : z의 부모가 조부모의 왼쪽 노드 일 때.
     if(z->parent == z->parent->parent->left) {
       node_t *uncle = z->parent->parent->right; // 삼촌 노드(부모의 형제)
@@ -122,6 +508,7 @@ static void rbtree_insert_fixup(rbtree *t, node_t *z) {
         z->parent->color = RBTREE_BLACK;  // z의 부모의 색깔은 BLACK
         uncle->color = RBTREE_BLACK;      // 삼촌 노드의 색깔도 BLACK
         z->parent->parent->color = RBTREE_RED;  // 할아버지(조부모)의 색상은 RED
+        STAT_ADD(t, recolors, 3);
         z = z->parent->parent;  // z는 본인의 할아버지(조부모) 노드로 교체
       
       // Case A.2 & A.3 : 삼촌이 BLACK인 경우 -> 색상 변경
@@ -134,6 +521,7 @@ static void rbtree_insert_fixup(rbtree *t, node_t *z) {
         // Case A.3 : z가 '왼쪽' 자식이라 직선 모양(line)일 때
         z->parent->color = RBTREE_BLACK;  // z의 부모의 색깔은 BLACK
         z->parent->parent->color = RBTREE_RED;  // z의 조부모 색깔은 RED
+        STAT_ADD(t, recolors, 2);
         right_rotate(t, z->parent->parent); // 조부모를 기준으로 오른쪽 회전
       }
     // Case B : z의 부모가 조부모의 '오른쪽' 자식인 경우 (A와 대칭)
@@ -145,6 +533,7 @@ static void rbtree_insert_fixup(rbtree *t, node_t *z) {
         z->parent->color = RBTREE_BLACK;  // z의 부모의 색은 BLACK
         uncle->color = RBTREE_BLACK;      // 삼촌의 색도 BLACK
         z->parent->parent->color = RBTREE_RED;  // 조부모의 색깔은 RED
+        STAT_ADD(t, recolors, 3);
         z = z->parent->parent;  // z를 본인의 조부모 노드로 지정
       // Case B.2 & B.3 : 삼촌이 BLACK인 경우 -> 회전 필요
       } else {
@@ -156,111 +545,272 @@ static void rbtree_insert_fixup(rbtree *t, node_t *z) {
         // Case B.3 : z가 '오른쪽' 자식이라 직선 모양(line)일 때
         z->parent->color = RBTREE_BLACK;  // z의 부모의 색은 BLACK
         z->parent->parent->color = RBTREE_RED;  // z의 조부모의 색은 RED
+        STAT_ADD(t, recolors, 2);
         left_rotate(t, z->parent->parent);      // z의 조부모를 기준으로 왼쪽 회전
       }
     }
   }
   // 루프(loop)가 끝나면, 트리의 루트는 항상 BLACK이어야 한다는 규칙을 적용.
+  const int grew = t->root->color == RBTREE_RED;
   t->root->color = RBTREE_BLACK;
+  return grew;
 }
 
 // 삭제 후 RBTREE의 조건에 부합한지 확인하는 함수
-static void rbtree_delete_fixup(rbtree *t, node_t *x) {
+// xp : x의 부모 (x가 nil일 수 있으므로 nil의 parent에 기대지 않고 따로 전달받음)
+static void rbtree_delete_fixup(rbtree *t, node_t *x, node_t *xp) {
   while (x != t->root && x->color == RBTREE_BLACK) {
+    STAT_ADD(t, delete_fixup_loops, 1);
     // x가 왼쪽 자식인 경우
-    if (x == x->parent->left) {
-      node_t *uncle = x->parent->right; // uncle은 형제 노드(삼촌 노드)
+    if (x == xp->left) {
+      node_t *uncle = xp->right; // uncle은 형제 노드(삼촌 노드)
 
       // Case 1: 형제가 RED
       if (uncle->color == RBTREE_RED) {
         uncle->color = RBTREE_BLACK;  // 삼촌의 색은 BLACK
-        x->parent->color = RBTREE_RED; // x의 부모의 색은 RED
-        left_rotate(t, x->parent);  // x의 부모를 기준으로 왼쪽 회전
-        uncle = x->parent->right; // 삼촌 노드는 x의 부모의 오른쪽 자식
+        xp->color = RBTREE_RED; // x의 부모의 색은 RED
+        STAT_ADD(t, recolors, 2);
+        left_rotate(t, xp);  // x의 부모를 기준으로 왼쪽 회전
+        uncle = xp->right; // 삼촌 노드는 x의 부모의 오른쪽 자식
       }
 
       // Case 2: 형제의 두 자식이 모두 BLACK
       if (uncle->left->color == RBTREE_BLACK && uncle->right->color == RBTREE_BLACK) {
         uncle->color = RBTREE_RED;  // 삼촌의 색은 RED
-        x = x->parent;  // x는 x의 부모로 지정
+        STAT_ADD(t, recolors, 1);
+        x = xp;  // x는 x의 부모로 지정
+        xp = x->parent;  // 한 칸 올라간 x의 부모
       } else {
         // Case 3: 형제의 오른쪽 자식만 BLACK
         if (uncle->right->color == RBTREE_BLACK) {
           uncle->left->color = RBTREE_BLACK;  // 삼촌노드의 왼쪽 자식의 색은 BLACK
           uncle->color = RBTREE_RED;          // 삼촌노드의 색은 RED
+          STAT_ADD(t, recolors, 2);
           right_rotate(t, uncle); // 삼촌노드를 기준으로 오른쪽 회전
-          uncle = x->parent->right; // 삼촌노드는 x의 부모의 오른쪽 자식노드
+          uncle = xp->right; // 삼촌노드는 x의 부모의 오른쪽 자식노드
         }
         
         // Case 4: 형제의 오른쪽 자식은 RED
-        uncle->color = x->parent->color;  // 삼촌의 색은 x의 부모의 색깔과 같다.
-        x->parent->color = RBTREE_BLACK;  // x의 부모의 색깔은 BLACK
+        uncle->color = xp->color;  // 삼촌의 색은 x의 부모의 색깔과 같다.
+        xp->color = RBTREE_BLACK;  // x의 부모의 색깔은 BLACK
         uncle->right->color = RBTREE_BLACK; // 삼촌의 오른쪽 자식의 색은 BLACK
-        left_rotate(t, x->parent);  // x의 부모를 기준으로 왼쪽 회전
+        STAT_ADD(t, recolors, 3);
+        left_rotate(t, xp);  // x의 부모를 기준으로 왼쪽 회전
         x = t->root; // 루프 종료
       }
     } 
     // x가 오른쪽 자식인 경우 (대칭)
     else {
-      node_t *uncle = x->parent->left; // uncle은 형제 노드
+      node_t *uncle = xp->left; // uncle은 형제 노드
 
       // Case 1: 형제가 RED
       if (uncle->color == RBTREE_RED) {
         uncle->color = RBTREE_BLACK;  //  삼촌 노드의 색은 BLACK
-        x->parent->color = RBTREE_RED;  // x의 부모의 색은 RED
-        right_rotate(t, x->parent); // x의 부모를 기준으로 오른쪽 회전
-        uncle = x->parent->left;  // 삼촌 노드는 x의 부모가 가진 왼쪽 자식이다.
+        xp->color = RBTREE_RED;  // x의 부모의 색은 RED
+        STAT_ADD(t, recolors, 2);
+        right_rotate(t, xp); // x의 부모를 기준으로 오른쪽 회전
+        uncle = xp->left;  // 삼촌 노드는 x의 부모가 가진 왼쪽 자식이다.
       }
 
       // Case 2: 형제의 두 자식이 모두 BLACK
       if (uncle->right->color == RBTREE_BLACK && uncle->left->color == RBTREE_BLACK) {
         uncle->color = RBTREE_RED;  // 삼촌의 색은 RED
-        x = x->parent;  // x는 자신의 부모로 지정해줌.
+        STAT_ADD(t, recolors, 1);
+        x = xp;  // x는 자신의 부모로 지정해줌.
+        xp = x->parent;  // 한 칸 올라간 x의 부모
       } else {
         // Case 3: 형제의 왼쪽 자식만 BLACK
         if (uncle->left->color == RBTREE_BLACK) {
           uncle->right->color = RBTREE_BLACK; // 삼촌의 오른쪽 자식의 색은 BLACK
           uncle->color = RBTREE_RED; // 삼촌의 색은 RED
+          STAT_ADD(t, recolors, 2);
           left_rotate(t, uncle);  // 삼촌을 기준으로 왼쪽 회전
-          uncle = x->parent->left;  // 삼촌 노드의 값은 x의 부모의 왼쪽
+          uncle = xp->left;  // 삼촌 노드의 값은 x의 부모의 왼쪽
         }
 
         // Case 4: 형제의 왼쪽 자식은 RED
-        uncle->color = x->parent->color;  // 삼촌의 색은 x의 부모의 색이다.
-        x->parent->color = RBTREE_BLACK;  // x의 부모의 색은 BLACK이다.
+        uncle->color = xp->color;  // 삼촌의 색은 x의 부모의 색이다.
+        xp->color = RBTREE_BLACK;  // x의 부모의 색은 BLACK이다.
         uncle->left->color = RBTREE_BLACK;  // 삼촌의 왼쪽 자식의 색은 BLACK이다.
-        right_rotate(t, x->parent);  // x의 부모를 기준으로 오른쪽 회전.
+        STAT_ADD(t, recolors, 3);
+        right_rotate(t, xp);  // x의 부모를 기준으로 오른쪽 회전.
         x = t->root; // 루프 종료
       }
     }
   }
-  x->color = RBTREE_BLACK; // x의 색은 BLACK
+  if (x != t->nil) {
+    x->color = RBTREE_BLACK; // x의 색은 BLACK
+  }
 }
 
 // 새로운 레드-블랙 트리를 생성하고 초기화하는 함수
 rbtree *new_rbtree(void) {
+  return new_rbtree_ex(NULL);
+}
+
+// 설정(config)에 따라 레드-블랙 트리를 생성하는 함수
+// config가 NULL이거나 pool_chunk가 0이면 노드마다 malloc/free를 사용
+rbtree *new_rbtree_ex(const rbtree_config *config) {
   // rbtree 구조체 크기만큼 메모리 할당 후 0으로 초기화
   rbtree *p = (rbtree *)calloc(1, sizeof(rbtree));
 
-  // nil(센티넬) 노드를 하나 생성
-  node_t *nil = (node_t *)malloc(sizeof *nil);
-  nil->color = RBTREE_BLACK;          // nil 노드는 항상 BLACK
-  nil->left = nil->right = nil->parent = nil; // 자기 자신을 가리키게 해서 경계 조건 단순화
+  // slab allocator를 쓰도록 설정했다면 pool 생성
+  if (config != NULL && config->pool_chunk > 0) {
+    p->pool = pool_create(config->pool_chunk);
+  }
 
-  // 트리의 nil 포인터와 root를 nil 노드로 설정
-  p->nil = nil;
+  // 트리의 nil 포인터와 root를 공유 nil 노드로 설정
+  p->nil = (node_t *)&rbtree_nil;
   p->root = p->nil;
+  p->leftmost = p->rightmost = p->nil;
 
   // 초기화된 트리 반환
   return p;
 }
 
+// 정렬된 arr[lo, hi) 구간으로 완전 균형 서브트리를 만들고 그 루트를 반환하는 함수
+// nodes가 NULL이 아니면 새로 할당하지 않고 정렬된 기존 노드 nodes[lo, hi)를 다시 연결한다.
+// depth : 현재 노드의 깊이, red_depth : 빨간색으로 칠할 깊이 (마지막 레벨이 덜 찼을 때만, 아니면 -1)
+// 노드는 중위 순서대로 할당되므로 pool 안에서 key 순서대로 연속해서 놓인다.
+static node_t *build_balanced(rbtree *t, const key_t *arr, node_t **nodes, const size_t lo,
+                              const size_t hi, const int depth, const int red_depth) {
+  if (lo >= hi) {
+    return t->nil;
+  }
+
+  const size_t mid = lo + (hi - lo) / 2;
+
+  // 왼쪽 서브트리를 먼저 만든 뒤 현재 노드를 할당 (할당 순서 = key 순서)
+  node_t *left = build_balanced(t, arr, nodes, lo, mid, depth + 1, red_depth);
+  node_t *z;
+  if (nodes != NULL) {
+    z = nodes[mid];
+  } else {
+    z = node_new(t, arr[mid]);
+  }
+  z->left = left;
+  z->right = build_balanced(t, arr, nodes, mid + 1, hi, depth + 1, red_depth);
+  update_size(z);
+  update_max(z);
+
+  // 모든 nil까지의 경로에는 depth < red_depth 인 BLACK 노드 수가 같으므로
+  // 덜 찬 마지막 레벨만 RED로 칠하면 RB 속성이 유지됨
+  z->color = (depth == red_depth) ? RBTREE_RED : RBTREE_BLACK;
+
+  if (z->left != t->nil) {
+    z->left->parent = z;
+  }
+  if (z->right != t->nil) {
+    z->right->parent = z;
+  }
+  return z;
+}
+
+// n개의 노드로 만든 완전 균형 트리의 레벨 수
+static int balanced_levels(const size_t n) {
+  int levels = 0;
+  while (((size_t)1 << levels) - 1 < n) {
+    levels++;
+  }
+  return levels;
+}
+
+// 트리를 n개의 노드로 완전 균형 상태로 다시 만드는 함수 (arr 또는 nodes 중 하나로부터)
+static void build_tree(rbtree *t, const key_t *arr, node_t **nodes, const size_t n) {
+  // 트리의 레벨 수를 구하고, 마지막 레벨이 꽉 차지 않았다면 그 레벨을 RED로 칠함
+  const int levels = balanced_levels(n);
+  const int red_depth = (((size_t)1 << levels) - 1 == n) ? -1 : levels - 1;
+
+  t->root = build_balanced(t, arr, nodes, 0, n, 0, red_depth);
+  if (t->root != t->nil) {
+    t->root->parent = t->nil;
+  }
+  reset_ends(t);
+#ifdef RBTREE_COUNTED
+  // 노드마다 같은 key가 여러 개 들어있을 수 있으므로 노드 수가 아니라 key 수를 셈
+  t->count = 0;
+  for (size_t i = 0; i < n; i++) {
+    t->count += nodes[i]->copies;
+  }
+#else
+  t->count = n;
+#endif
+}
+
+// 정렬된 배열 arr[0, n)로부터 O(n)에 레드-블랙 트리를 만드는 함수
+// 노드는 한 덩어리(pool_reserve)에 key 순서대로 연속 할당되고, 이후 삽입은 RBTREE_POOL_CHUNK 크기의 chunk를 쓴다.
+rbtree *rbtree_from_sorted(const key_t *arr, const size_t n) {
+  return rbtree_from_sorted_ex(arr, n, NULL);
+}
+
+// rbtree_from_sorted와 같지만 이후 삽입에 쓸 할당자를 config로 정하는 함수 (NULL이면 기본값)
+// pool_chunk가 0이면 노드마다 malloc하므로 한 덩어리로 할당하지 않는다.
+rbtree *rbtree_from_sorted_ex(const key_t *arr, const size_t n, const rbtree_config *config) {
+  const rbtree_config defaults = {.pool_chunk = RBTREE_POOL_CHUNK};
+  rbtree *t = new_rbtree_ex(config != NULL ? config : &defaults);
+#ifdef RBTREE_COUNTED
+  // 같은 key가 이어진 구간마다 노드를 하나만 만들고, 구간 길이를 copies로 둠
+  size_t distinct = 0;
+  for (size_t i = 0; i < n; i++) {
+    distinct += (i == 0 || arr[i] != arr[i - 1]);
+  }
+  if (t->pool != NULL) {
+    pool_reserve(t->pool, distinct);
+  }
+
+  node_t **nodes = (node_t **)malloc((distinct > 0 ? distinct : 1) * sizeof(node_t *));
+  size_t d = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (d > 0 && nodes[d - 1]->key == arr[i]) {
+      nodes[d - 1]->copies++;
+    } else {
+      nodes[d++] = node_new(t, arr[i]);
+    }
+  }
+  build_tree(t, NULL, nodes, distinct);
+  free(nodes);
+#else
+  if (t->pool != NULL) {
+    pool_reserve(t->pool, n);
+  }
+  build_tree(t, arr, NULL, n);
+#endif
+  return t;
+}
+
+static int key_compare(const void *a, const void *b) {
+  const key_t x = *(const key_t *)a;
+  const key_t y = *(const key_t *)b;
+  return (x > y) - (x < y);
+}
+
+// 정렬되지 않은 배열로부터 트리를 만드는 함수 (복사본을 정렬한 뒤 rbtree_from_sorted 사용)
+rbtree *rbtree_from_array(const key_t *arr, const size_t n) {
+  key_t *sorted = (key_t *)malloc((n > 0 ? n : 1) * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = arr[i];
+  }
+  qsort(sorted, n, sizeof(key_t), key_compare);
+
+  rbtree *t = rbtree_from_sorted(sorted, n);
+  free(sorted);
+  return t;
+}
+
 void delete_rbtree(rbtree *t) {
-  // 트리의 루트(root)에서부터 시작하여 모든 노드를 재귀적으로 삭제
-  recursion_delete_tree(t->root, t->nil);
+  if (t->pool != NULL && t->pool->refs == 1) {
+    // pool을 혼자 쓰는 트리는 순회 없이 chunk들만 해제
+    pool_destroy(t->pool);
+  } else {
+    // 트리의 루트(root)에서부터 시작하여 모든 노드를 삭제
+    // (다른 트리와 함께 쓰는 pool이라면 노드를 pool에 돌려줌)
+    delete_subtree(t, t->root);
+    if (t->pool != NULL) {
+      pool_release(t->pool);
+    }
+  }
 
-  // 모든 노드가 삭제된 후, 센티널(nil) 노드의 메모리를 해제
-  free(t->nil);
+  // nil 노드는 모든 트리가 공유하므로 해제하지 않음
 
   // 마지막으로 트리 구조체 자체의 메모리를 해제
   free(t);
@@ -272,21 +822,30 @@ node_t *rbtree_insert(rbtree *t, const key_t key) {
 
   node_t *y = t->nil;  // y는 부모가 될 노드를 추적
   node_t *x = t->root; // x는 트리를 탐색하는 포인터이다.
-  node_t *z = (node_t *)malloc(sizeof(node_t));
-
-  z->key = key;
 
   while (x != t->nil){  // z가 삽입될 위치를 찾는다.
     y = x; // 부모가 될 y노드에 기본 트리의 root노드를 담아줌 (임시) 
+#ifndef RBTREE_NO_ORDER_STATS
+    y->size++; // z는 y의 서브트리에 들어가므로 경로 위 노드들의 크기를 1 늘림
+#endif
+#ifdef RBTREE_COUNTED
+    if (key == x->key) {  // 같은 key의 노드가 있으면 개수만 늘림 (경로의 크기는 이미 늘렸음)
+      x->copies++;
+      t->count++;
+      STAT_ADD(t, inserts, 1);
+      return x;
+    }
+#endif
     
     // binary tree의 삽입 방식과 유사
-    if (z->key < x->key){ // 삽입하고 싶은 노드 z가 루트 노드인 x보다 작을 경우
+    if (key < x->key){ // 삽입하고 싶은 노드 z가 루트 노드인 x보다 작을 경우
       x = x->left;        // 루트 노드 x의 왼쪽으로
     } else {              // 삽입하고 싶은 노드 z가 루트 노드인 x보다 크거나 같을 경우 
       x = x->right;       // 루트 노드 x의 오른쪽으로
     }                     // 주어진 tree의 노드의 값을 루프(loop)를 통해 비교하여 자기 위치를 찾아감 
   }
   
+  node_t *z = node_new(t, key);
   z->parent = y; // 삽입하고싶은 노드 z의 부모는 y가 될 것임
 
   if (y == t->nil){ // y의 값이 tree의 nil 노드라면
@@ -302,6 +861,11 @@ node_t *rbtree_insert(rbtree *t, const key_t key) {
   z->left = t->nil;           // 삽입된 z노드의 왼쪽 자식은 트리노드의 nil노드가 될 것이고
   z->right = t->nil;          // 오른쪽 자식도 nil 노드가 될 것
   z->color = RBTREE_RED; // RB 트리에서 삽입되는 새로운 노드의 색은 RED이다.
+  update_size(z);
+  extend_ends(t, z);
+  fix_max_path(t, y);
+  t->count++;
+  STAT_ADD(t, inserts, 1);
 
   // fix-up 함수를 호출하여 RB-Tree 속성을 유지하게 함. (속성을 위반했을 수도 있으니)
   rbtree_insert_fixup(t, z);
@@ -310,13 +874,231 @@ node_t *rbtree_insert(rbtree *t, const key_t key) {
   return z;
 }
 
+// key 순서상 이웃한 두 노드 a, b (a가 앞, 없으면 nil) 사이에 key를 넣는 함수
+// a의 오른쪽이 비어 있으면 a의 오른쪽 자식으로, 아니면 b가 a의 오른쪽 서브트리의 가장 왼쪽 노드이므로
+// b의 왼쪽 자식으로 붙인다. 루트에서 내려오지 않으므로 key 비교가 필요 없다.
+static node_t *insert_between(rbtree *t, node_t *a, node_t *b, const key_t key) {
+#ifdef RBTREE_COUNTED
+  // 이웃 중 같은 key의 노드가 있으면 개수만 늘림
+  node_t *same = (a != t->nil && a->key == key) ? a : (b != t->nil && b->key == key) ? b : t->nil;
+  if (same != t->nil) {
+    same->copies++;
+    grow_path(t, same, 1);
+    t->count++;
+    STAT_ADD(t, inserts, 1);
+    return same;
+  }
+#endif
+  node_t *z = node_new(t, key);
+  if (a != t->nil && a->right == t->nil) {
+    z->parent = a;
+    a->right = z;
+  } else {
+    z->parent = b;
+    b->left = z;
+  }
+  z->left = t->nil;
+  z->right = t->nil;
+  z->color = RBTREE_RED;
+  update_size(z);
+  extend_ends(t, z);
+  grow_path(t, z->parent, 1);
+  fix_max_path(t, z->parent);
+  t->count++;
+  STAT_ADD(t, inserts, 1);
+
+  rbtree_insert_fixup(t, z);
+  return z;
+}
+
+// hint 바로 옆에 key가 들어갈 자리가 있으면 루트에서 내려오지 않고 그 자리에 삽입
+// (hint <= key <= 다음 노드, 또는 이전 노드 <= key < hint)
+// 맞지 않는 hint나 NULL이면 rbtree_insert와 같이 루트부터 찾는다.
+node_t *rbtree_insert_hint(rbtree *t, node_t *hint, const key_t key) {
+  if (hint == NULL || hint == t->nil) {
+    return rbtree_insert(t, key);
+  }
+
+  // hint가 양 끝 노드면 이웃이 없으므로 루트까지 올라가며 찾지 않음 (정렬된 입력은 항상 이 경우)
+  if (hint->key <= key) {
+    node_t *next = (hint == t->rightmost) ? t->nil : rbtree_next(t, hint);
+    if (next == t->nil || key <= next->key) {
+      return insert_between(t, hint, next, key);
+    }
+  } else {
+    node_t *prev = (hint == t->leftmost) ? t->nil : rbtree_prev(t, hint);
+    if (prev == t->nil || prev->key <= key) {
+      return insert_between(t, prev, hint, key);
+    }
+  }
+  return rbtree_insert(t, key);
+}
+
+typedef struct {
+  key_t *base;
+  size_t n;
+} sort_job;
+
+static void *sort_worker(void *arg) {
+  sort_job *job = (sort_job *)arg;
+  qsort(job->base, job->n, sizeof(key_t), key_compare);
+  return NULL;
+}
+
+// 정렬된 두 구간 a, b를 out으로 병합 (같은 key는 a 쪽이 먼저)
+static void merge_runs(const key_t *a, const size_t na, const key_t *b, const size_t nb, key_t *out) {
+  size_t i = 0, j = 0, k = 0;
+  while (i < na && j < nb) {
+    out[k++] = (b[j] < a[i]) ? b[j++] : a[i++];
+  }
+  while (i < na) {
+    out[k++] = a[i++];
+  }
+  while (j < nb) {
+    out[k++] = b[j++];
+  }
+}
+
+// arr[0, n)를 정렬하는 함수
+// 큰 배치는 조각으로 나눠 스레드마다 정렬한 뒤, 정렬된 조각들을 두 개씩 병합한다.
+static void sort_keys(key_t *arr, const size_t n) {
+  const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t nthreads = (ncpu > BATCH_MAX_THREADS) ? BATCH_MAX_THREADS : (ncpu > 0 ? (size_t)ncpu : 1);
+
+  if (n < BATCH_PARALLEL_MIN || nthreads < 2) {
+    qsort(arr, n, sizeof(key_t), key_compare);
+    return;
+  }
+
+  sort_job jobs[BATCH_MAX_THREADS];
+  pthread_t threads[BATCH_MAX_THREADS];
+  size_t bounds[BATCH_MAX_THREADS + 1];
+  for (size_t i = 0; i <= nthreads; i++) {
+    bounds[i] = n / nthreads * i + (i == nthreads ? n % nthreads : 0);
+  }
+
+  // 첫 조각은 현재 스레드가 직접 정렬
+  // 스레드를 만들지 못한 조각(EAGAIN 등)도 현재 스레드가 정렬하고, 만든 스레드만 기다림
+  int started[BATCH_MAX_THREADS] = {0};
+  for (size_t i = 0; i < nthreads; i++) {
+    jobs[i].base = arr + bounds[i];
+    jobs[i].n = bounds[i + 1] - bounds[i];
+    if (i > 0) {
+      started[i] = pthread_create(&threads[i], NULL, sort_worker, &jobs[i]) == 0;
+    }
+  }
+  for (size_t i = 0; i < nthreads; i++) {
+    if (!started[i]) {
+      sort_worker(&jobs[i]);
+    }
+  }
+  for (size_t i = 1; i < nthreads; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  // 조각들을 두 개씩 병합하며 조각 수를 절반으로 줄임
+  key_t *src = arr;
+  key_t *dst = (key_t *)malloc(n * sizeof(key_t));
+  key_t *tmp = dst;
+  size_t runs = nthreads;
+  while (runs > 1) {
+    size_t merged = 0;
+    for (size_t r = 0; r < runs; r += 2) {
+      const size_t lo = bounds[r];
+      const size_t mid = bounds[r + 1];
+      const size_t hi = (r + 2 <= runs) ? bounds[r + 2] : mid;
+      merge_runs(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+      bounds[merged++] = lo;
+    }
+    bounds[merged] = n;
+    runs = merged;
+
+    key_t *swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if (src != arr) {
+    memcpy(arr, src, n * sizeof(key_t));
+  }
+  free(tmp);
+}
+
+// key 배열 keys[0, m)을 한꺼번에 삽입하는 함수
+// 배치를 (크면 여러 스레드로) 정렬한 뒤, 아주 작은 배치는 하나씩 삽입하고,
+// 트리보다 충분히 작은 배치는 균형 트리로 만들어 union으로 합치고 (O(m log(n/m + 1))),
+// 트리와 비슷하거나 큰 배치는 기존 노드와 새 노드를 key 순서로 병합해 O(n + m)에 균형 트리로 다시 연결한다.
+// 기존 노드는 다시 연결만 되므로 이미 가지고 있는 node pointer는 계속 유효하다.
+int rbtree_insert_many(rbtree *t, const key_t *keys, const size_t m) {
+  if (m == 0) {
+    return 0;
+  }
+
+  key_t *batch = (key_t *)malloc(m * sizeof(key_t));
+  memcpy(batch, keys, m * sizeof(key_t));
+  sort_keys(batch, m);
+
+  const size_t n = t->count;
+
+  // 아주 작은 배치는 하나씩 삽입
+  if (m < INSERT_MANY_SINGLE_MAX) {
+    for (size_t i = 0; i < m; i++) {
+      rbtree_insert(t, batch[i]);
+    }
+    free(batch);
+    return 0;
+  }
+
+  // 트리에 비해 작은 배치는 균형 트리로 만든 뒤 split/join 기반의 union으로 합침 (O(m log(n/m + 1)))
+  // 배치 트리는 t와 같은 방식으로 할당하므로 union이 그 pool을 t의 pool로 흡수한다.
+  if (m * INSERT_MANY_REBUILD_RATIO < n) {
+    const rbtree_config config = {.pool_chunk = (t->pool != NULL) ? t->pool->chunk_nodes : 0};
+    rbtree *b = rbtree_from_sorted_ex(batch, m, &config);
+    free(batch);
+    rbtree_union(t, b);
+    delete_rbtree(b);
+    STAT_ADD(t, inserts, m);
+    return 0;
+  }
+
+  // 기존 노드(중위 순서)와 새 노드를 key 순서대로 병합, 같은 key면 기존 노드가 앞
+  node_t **nodes = (node_t **)malloc((n + m) * sizeof(node_t *));
+  node_t *x = rbtree_min(t);
+  size_t i = 0, k = 0;
+  while (x != t->nil || i < m) {
+    if (x != t->nil && (i == m || x->key <= batch[i])) {
+      nodes[k++] = x;
+      x = rbtree_next(t, x);
+#ifdef RBTREE_COUNTED
+    } else if (k > 0 && nodes[k - 1]->key == batch[i]) {
+      nodes[k - 1]->copies++;  // 바로 앞 노드와 같은 key면 개수만 늘림 (크기는 build_tree가 다시 계산)
+      i++;
+#endif
+    } else {
+      nodes[k++] = node_new(t, batch[i++]);
+    }
+  }
+
+  build_tree(t, NULL, nodes, k);
+  STAT_ADD(t, inserts, m);
+
+  free(nodes);
+  free(batch);
+  return 0;
+}
+
 // 주어진 key 값과 일치하는 노드를 트리에서 찾는 함수
 node_t *rbtree_find(const rbtree *t, const key_t key) {
   node_t *x = t->root;   // 루트에서 시작
+  size_t depth = 0;      // 방문한 노드 수 (RBTREE_STATS 용)
   
   // nil(=리프 노드) 도달할 때까지 탐색
   while (x != t->nil) {
+    depth++;
     if (x->key == key) {         // 찾는 key가 현재 노드 key와 같으면
+      STAT_ADD(t, finds, 1);
+      STAT_FIND(t, depth);
       return x;                  // 해당 노드 반환
     } else if (x->key > key) {   // 찾는 key가 현재보다 작으면
       x = x->left;               // 왼쪽 서브트리로 이동
@@ -326,56 +1108,315 @@ node_t *rbtree_find(const rbtree *t, const key_t key) {
   }
 
   // 끝까지 못 찾으면 NULL 반환
+  STAT_ADD(t, finds, 1);
+  STAT_FIND(t, depth);
   return NULL;
 }
 
-// 트리에서 가장 작은 key(최소값)를 가진 노드를 반환하는 함수
-node_t *rbtree_min(const rbtree *t) {
-  node_t *current = t->root;  // 루트부터 시작
+// 트리에 들어있는 key의 개수를 O(1)에 반환하는 함수
+size_t rbtree_size(const rbtree *t) {
+  return t->count;
+}
+
+// k번째(0부터 시작)로 작은 key를 가진 노드를 반환하는 함수, k가 범위를 벗어나면 nil 반환
+node_t *rbtree_select(const rbtree *t, const size_t k) {
+#ifndef RBTREE_NO_ORDER_STATS
+  // 왼쪽 서브트리 크기와 비교하며 내려가므로 O(log n)
+  node_t *x = t->root;
+  size_t rest = k;
+
+  while (x != t->nil) {
+    const size_t left_size = x->left->size;
+    if (rest < left_size) {
+      x = x->left;
+    } else if (rest < left_size + node_copies(t, x)) {
+      return x;
+    } else {
+      rest -= left_size + node_copies(t, x);  // 왼쪽 서브트리와 x를 건너뜀
+      x = x->right;
+    }
+  }
+  return t->nil;
+#else
+  // 서브트리 크기가 없으면 최솟값부터 k칸 이동 (O(k))
+  node_t *x = rbtree_min(t);
+  size_t rest = k;
+  while (x != t->nil && rest >= node_copies(t, x)) {
+    rest -= node_copies(t, x);
+    x = rbtree_next(t, x);
+  }
+  return x;
+#endif
+}
+
+// key보다 작은 key의 개수를 반환하는 함수 (= key의 lower_bound 위치)
+size_t rbtree_rank(const rbtree *t, const key_t key) {
+  size_t rank = 0;
+#ifndef RBTREE_NO_ORDER_STATS
+  node_t *x = t->root;
+
+  while (x != t->nil) {
+    if (x->key < key) {  // x와 x의 왼쪽 서브트리는 모두 key보다 작음
+      rank += x->left->size + node_copies(t, x);
+      x = x->right;
+    } else {
+      x = x->left;
+    }
+  }
+#else
+  for (node_t *x = rbtree_min(t); x != t->nil && x->key < key; x = rbtree_next(t, x)) {
+    rank += node_copies(t, x);
+  }
+#endif
+  return rank;
+}
+
+// key 이상인 첫 노드를 반환하는 함수, 없으면 nil 반환
+// 같은 key가 여러 개 있으면 그 중 중위 순서상 가장 앞의 노드를 반환
+node_t *rbtree_lower_bound(const rbtree *t, const key_t key) {
+  node_t *x = t->root;
+  node_t *candidate = t->nil;  // 지금까지 찾은 key 이상인 노드 중 가장 작은 노드
+
+  while (x != t->nil) {
+    if (x->key >= key) {  // 조건을 만족하면 후보로 기록하고 더 작은 쪽을 탐색
+      candidate = x;
+      x = x->left;
+    } else {
+      x = x->right;
+    }
+  }
+  return candidate;
+}
+
+// key보다 큰 첫 노드를 반환하는 함수, 없으면 nil 반환
+node_t *rbtree_upper_bound(const rbtree *t, const key_t key) {
+  node_t *x = t->root;
+  node_t *candidate = t->nil;
+
+  while (x != t->nil) {
+    if (x->key > key) {
+      candidate = x;
+      x = x->left;
+    } else {
+      x = x->right;
+    }
+  }
+  return candidate;
+}
+
+// [lo, hi) 범위의 key를 순서대로 arr에 최대 n개 저장하고, 저장한 개수를 반환하는 함수
+// lower_bound 한 번 + successor 이동 k번이므로 O(log n + k)
+size_t rbtree_range(const rbtree *t, const key_t lo, const key_t hi, key_t *arr, const size_t n) {
+  size_t count = 0;
+  node_t *x = rbtree_lower_bound(t, lo);
 
-  if (current == t->nil) {    // 트리가 비어있으면
-    return t->nil;            // nil 반환
+  while (x != t->nil && x->key < hi && count < n) {
+    for (size_t c = node_copies(t, x); c > 0 && count < n; c--) {
+      arr[count++] = x->key;
+    }
+    x = rbtree_next(t, x);
   }
+  return count;
+}
 
-  // 왼쪽 자식이 있는 동안 계속 왼쪽으로 이동
-  while (current->left != t->nil) {
-    current = current->left;
+// [lo, hi) 범위의 노드마다 visit을 호출하는 함수, visit이 0이 아닌 값을 반환하면 중단
+// 방문한 노드 수를 반환
+size_t rbtree_range_foreach(const rbtree *t, const key_t lo, const key_t hi, rbtree_visit_fn visit, void *arg) {
+  size_t count = 0;
+  node_t *x = rbtree_lower_bound(t, lo);
+
+  while (x != t->nil && x->key < hi) {
+    // 콜백이 현재 노드를 삭제해도 되도록 다음 노드를 미리 구해둠
+    node_t *next = rbtree_next(t, x);
+    count++;
+    if (visit(x, arg)) {
+      break;
+    }
+    x = next;
   }
+  return count;
+}
+
+#ifdef RBTREE_INTERVAL
+// 구간 [lo, hi]를 lo를 key로 삽입하는 함수
+// 끝이 key인 점 구간으로 넣은 뒤 끝을 hi로 바꾸고 그 위의 max_hi만 다시 계산한다.
+node_t *rbtree_insert_interval(rbtree *t, const key_t lo, const key_t hi) {
+  node_t *z = rbtree_insert(t, lo);
+  z->hi = hi;
+  fix_max_path(t, z);
+  return z;
+}
 
-  // 가장 왼쪽 노드(=최소값 노드) 반환
-  return current;
+// [lo, hi]와 겹치는 구간 중 시작점이 가장 작은 것을 반환, 없으면 NULL (O(log n))
+// 왼쪽 서브트리의 max_hi가 lo 이상인데 그 안에 겹치는 구간이 없다면, max_hi를 가진 구간이
+// hi보다 뒤에서 시작한다는 뜻이므로 x와 오른쪽 서브트리도 겹치지 않는다. 따라서 되돌아올 필요가 없다.
+node_t *rbtree_interval_overlaps(const rbtree *t, const key_t lo, const key_t hi) {
+  node_t *x = t->root;
+  while (x != t->nil && x->max_hi >= lo) {
+    if (x->left != t->nil && x->left->max_hi >= lo) {
+      x = x->left;
+    } else if (x->key > hi) {
+      return NULL;  // x와 오른쪽 서브트리는 모두 hi보다 뒤에서 시작
+    } else if (x->hi >= lo) {
+      return x;
+    } else {
+      x = x->right;
+    }
+  }
+  return NULL;
 }
 
-// 트리에서 가장 큰 key(최대값)를 가진 노드를 반환하는 함수
+// 서브트리 x에서 [lo, hi]와 겹치는 구간을 시작점 순서대로 방문, visit이 0이 아닌 값을 반환하면 1 반환
+// max_hi가 lo보다 작은 서브트리와 hi보다 뒤에서 시작하는 오른쪽 서브트리는 내려가지 않는다.
+static int interval_visit(const rbtree *t, node_t *x, const key_t lo, const key_t hi, rbtree_visit_fn visit,
+                          void *arg, size_t *count) {
+  if (x == t->nil || x->max_hi < lo) {
+    return 0;
+  }
+  if (interval_visit(t, x->left, lo, hi, visit, arg, count)) {
+    return 1;
+  }
+  if (x->key > hi) {
+    return 0;
+  }
+  if (x->hi >= lo) {
+    (*count)++;
+    if (visit(x, arg)) {
+      return 1;
+    }
+  }
+  return interval_visit(t, x->right, lo, hi, visit, arg, count);
+}
+
+// [lo, hi]와 겹치는 구간마다 visit을 부르고 방문한 개수를 반환
+// 겹치는 구간이 있는 경로로만 내려가므로 결과 k개에 대해 O(log n + k) ~ O((k + 1) log n)
+size_t rbtree_interval_foreach(const rbtree *t, const key_t lo, const key_t hi, rbtree_visit_fn visit, void *arg) {
+  size_t count = 0;
+  interval_visit(t, t->root, lo, hi, visit, arg, &count);
+  return count;
+}
+#endif
+
+// 트리에서 가장 작은 key(최소값)를 가진 노드를 반환하는 함수, 빈 트리면 nil
+// 삽입과 삭제가 가장 왼쪽 노드를 계속 기억해 두므로 루트에서 내려가지 않는다. (O(1))
+node_t *rbtree_min(const rbtree *t) {
+  return t->leftmost;
+}
+
+// 트리에서 가장 큰 key(최대값)를 가진 노드를 반환하는 함수, 빈 트리면 nil (O(1))
 node_t *rbtree_max(const rbtree *t) {
-  node_t *current = t->root;  // 루트부터 시작
+  return t->rightmost;
+}
+
+// 중위 순서에서 p 다음 노드(successor)를 반환하는 함수, 없으면 nil 반환
+// parent 포인터를 따라가므로 스택 없이 amortized O(1)
+node_t *rbtree_next(const rbtree *t, const node_t *p) {
+  node_t *x = (node_t *)p;
 
-  if (current == t->nil) {    // 트리가 비어있으면
-    return t->nil;            // nil 반환
+  if (x == t->nil) {
+    return t->nil;
   }
 
-  // 오른쪽 자식이 있는 동안 계속 오른쪽으로 이동
-  while (current->right != t->nil) {
-    current = current->right;
+  // 오른쪽 서브트리가 있으면 그 서브트리의 최솟값이 다음 노드
+  if (x->right != t->nil) {
+    x = x->right;
+    while (x->left != t->nil) {
+      x = x->left;
+    }
+    return x;
   }
 
-  // 가장 오른쪽 노드(=최대값 노드) 반환
-  return current;
+  // 없으면 왼쪽 자식으로서 올라가게 되는 첫 조상이 다음 노드
+  node_t *y = x->parent;
+  while (y != t->nil && x == y->right) {
+    x = y;
+    y = y->parent;
+  }
+  return y;
 }
 
-int rbtree_erase(rbtree *t, node_t *p) {
-  node_t *y = p;  // y는 시렞로 트리에서 제거될 노드 또는 그 위치를 대체할 노드
+// 중위 순서에서 p 이전 노드(predecessor)를 반환하는 함수, 없으면 nil 반환 (rbtree_next와 대칭)
+node_t *rbtree_prev(const rbtree *t, const node_t *p) {
+  node_t *x = (node_t *)p;
+
+  if (x == t->nil) {
+    return t->nil;
+  }
+
+  if (x->left != t->nil) {
+    x = x->left;
+    while (x->right != t->nil) {
+      x = x->right;
+    }
+    return x;
+  }
+
+  node_t *y = x->parent;
+  while (y != t->nil && x == y->left) {
+    x = y;
+    y = y->parent;
+  }
+  return y;
+}
+
+// 최솟값 노드에서 시작하는 정방향 cursor
+void rbtree_cursor_first(rbtree_cursor *c, const rbtree *t) {
+  c->tree = t;
+  c->node = rbtree_min(t);
+}
+
+// 최댓값 노드에서 시작하는 역방향 cursor
+void rbtree_cursor_last(rbtree_cursor *c, const rbtree *t) {
+  c->tree = t;
+  c->node = rbtree_max(t);
+}
+
+// 트리 안의 임의의 노드에서 시작하는 cursor
+void rbtree_cursor_at(rbtree_cursor *c, const rbtree *t, node_t *p) {
+  c->tree = t;
+  c->node = (p != NULL) ? p : t->nil;  // rbtree_find 실패(NULL)도 끝 위치로 취급
+}
+
+// cursor가 아직 노드를 가리키고 있는지 확인 (양 끝을 넘어가면 0)
+int rbtree_cursor_valid(const rbtree_cursor *c) {
+  return c->node != c->tree->nil;
+}
+
+void rbtree_cursor_next(rbtree_cursor *c) {
+  c->node = rbtree_next(c->tree, c->node);
+}
+
+void rbtree_cursor_prev(rbtree_cursor *c) {
+  c->node = rbtree_prev(c->tree, c->node);
+}
+
+// 노드 p를 트리 구조에서 떼어내고 RB 속성을 복구하는 함수 (메모리 해제는 하지 않음)
+static void unlink_node(rbtree *t, node_t *p) {
+  node_t *y = p;  // y는 실제로 트리에서 제거될 노드 또는 그 위치를 대체할 노드
   node_t *x;      // x는 y의 원래 위치를 대체할 노드
+  node_t *xp;     // x의 부모 (x가 nil이어도 공유 nil에 쓰지 않도록 따로 기억)
   color_t y_original_color = y->color;  // y의 원래 색깔 저장
 
+  // 끝 노드가 빠지면 그 바로 안쪽 노드가 새 끝이 됨 : 끝 노드는 바깥쪽 자식이 없으므로 O(1)
+  if (p == t->leftmost) {
+    t->leftmost = rbtree_next(t, p);
+  }
+  if (p == t->rightmost) {
+    t->rightmost = rbtree_prev(t, p);
+  }
+
   // Case 1 : p의 왼쪽 자식이 없는 경우
   if (p->left == t->nil ) {
     x = p->right;
+    xp = p->parent;
+    shrink_path(t, p->parent, node_copies(t, p));
     transplant(t, p, p->right);
   }
   // Case 2 : p의 오른쪽 자식이 없는 경우
   else if (p->right == t->nil) {
     x = p->left;
+    xp = p->parent;
+    shrink_path(t, p->parent, node_copies(t, p));
     transplant(t, p, p->left);
   } 
   // Case 3 : p의 자식이 둘 다 있는 경우
@@ -386,10 +1427,18 @@ int rbtree_erase(rbtree *t, node_t *p) {
     }
     y_original_color = y->color;
     x = y->right;
+#ifndef RBTREE_NO_ORDER_STATS
+    // y가 빠지는 자리부터 p 아래까지는 y의 key 수만큼, p부터 루트까지는 p의 key 수만큼 크기 감소
+    for (node_t *w = y->parent; w != p; w = w->parent) {
+      w->size -= node_copies(t, y);
+    }
+#endif
+    shrink_path(t, p, node_copies(t, p));
 
     if (y->parent == p) { // y가 p의 바로 오른쪽 자식인 경우
-      x->parent = y;  // x의 부모를 y로 설정 (nil 노드일 경우에도 유효)
+      xp = y;  // x의 부모는 y가 됨 (x가 nil이어도 fixup에 전달)
     } else {  // y가 p의 자손이지만 바로 오른쪽 자식은 아닌 경우
+      xp = y->parent;
       transplant(t, y, y->right); // y의 오른쪽 자식을 y의 위치로 옮김
       y->right = p->right;
       y->right->parent = y;
@@ -398,22 +1447,733 @@ int rbtree_erase(rbtree *t, node_t *p) {
     y->left = p->left;
     y->left->parent = y;
     y->color = p->color;  // y의 색깔을 p의 색깔로 변경
+#ifndef RBTREE_NO_ORDER_STATS
+    y->size = p->size;    // y는 p의 자리를 그대로 물려받음 (p의 key는 이미 뺐음)
+#endif
   }
+  // 구조가 바뀐 가장 낮은 자리(x의 부모)부터 루트까지 : case 3에서 p 자리로 옮긴 y도 이 경로 위에 있음
+  fix_max_path(t, xp);
 
   // y의 원래 색깔이 BLACK이었다면, RB트리 속성 복구 필요
   if (y_original_color == RBTREE_BLACK) {
-    rbtree_delete_fixup(t, x);
+    rbtree_delete_fixup(t, x, xp);
   }
+}
+
+// rbtree_erase에서 메모리 해제만 뺀 함수 : 트리에서 빠진 노드를 반환하고, 노드가 남으면 NULL 반환
+// 다른 스레드가 아직 읽고 있을 수 있는 노드를 나중에 rbtree_free_node로 해제할 때 쓴다. (rbtree_rcu.c)
+node_t *rbtree_detach(rbtree *t, node_t *p) {
+  t->count--;
+  STAT_ADD(t, erases, 1);
+#ifdef RBTREE_COUNTED
+  // 같은 key가 더 남아있으면 개수만 줄이고 노드는 그대로 둠
+  if (p->copies > 1) {
+    p->copies--;
+    shrink_path(t, p, 1);
+    return NULL;
+  }
+#endif
+  unlink_node(t, p);
+  return p;
+}
 
-  free(p); // 삭제된 노드 p의 메모리 해제
+void rbtree_free_node(rbtree *t, node_t *p) {
+  node_free(t, p);
+}
+
+int rbtree_erase(rbtree *t, node_t *p) {
+  node_t *q = rbtree_detach(t, p);
+  if (q != NULL) {
+    node_free(t, q); // 삭제된 노드의 메모리 해제
+  }
   return 0;
 }
 
+// 끝 노드 p의 key를 *out에 저장하고 (같은 key가 여러 개면 하나만) 지움, 빈 트리면 0 반환
+// 우선순위 큐처럼 min을 꺼내고 지우는 일을 반복할 때 루트에서 다시 찾지 않고 한 번에 처리한다.
+static int pop_end(rbtree *t, node_t *p, key_t *out) {
+  if (p == t->nil) {
+    return 0;
+  }
+  *out = p->key;
+  rbtree_erase(t, p);
+  return 1;
+}
+
+int rbtree_pop_min(rbtree *t, key_t *out) {
+  return pop_end(t, t->leftmost, out);
+}
+
+int rbtree_pop_max(rbtree *t, key_t *out) {
+  return pop_end(t, t->rightmost, out);
+}
+
+// 한 스레드가 맡는 내보내기 조각 : 서브트리 하나 또는 위쪽 레벨의 노드 하나
+typedef struct {
+  node_t *root;
+  int single;     // 1이면 root 노드 하나만 (서브트리 전체가 아님)
+  size_t count;   // 조각의 key 수
+  size_t offset;  // 배열에서 조각이 시작하는 위치
+} export_task;
+
+typedef struct {
+  const rbtree *t;
+  export_task *tasks;
+  size_t ntasks;
+  size_t next;  // 다음에 가져갈 조각 번호 (atomic)
+  key_t *arr;
+  size_t n;
+  int counting;  // 1이면 조각 크기만 세고, 0이면 배열을 채움
+} export_job;
+
+// 위쪽 depth 레벨을 중위 순서로 내려가며 조각 목록을 만드는 함수
+static void collect_tasks(const rbtree *t, node_t *x, const int depth, export_task *tasks, size_t *ntasks) {
+  if (x == t->nil) {
+    return;
+  }
+  if (depth == 0) {
+    tasks[(*ntasks)++] = (export_task){.root = x, .single = 0};
+    return;
+  }
+  collect_tasks(t, x->left, depth - 1, tasks, ntasks);
+  tasks[(*ntasks)++] = (export_task){.root = x, .single = 1, .count = node_copies(t, x)};
+  collect_tasks(t, x->right, depth - 1, tasks, ntasks);
+}
+
+// 조각을 하나씩 가져가 처리하는 작업 스레드 (크기가 다른 조각들이 스레드 사이에 고르게 퍼지도록)
+static void *export_worker(void *arg) {
+  export_job *job = (export_job *)arg;
+  size_t i;
+  while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->ntasks) {
+    export_task *task = &job->tasks[i];
+    if (job->counting) {
+      task->count = task->single ? node_copies(job->t, task->root) : subtree_count(job->t, task->root);
+    } else if (task->offset < job->n) {
+      if (task->single) {
+        for (size_t j = task->offset; j < task->offset + task->count && j < job->n; j++) {
+          job->arr[j] = task->root->key;
+        }
+      } else {
+        inorder_traverse(job->t, task->root, job->arr + task->offset, job->n - task->offset);
+      }
+    }
+  }
+  return NULL;
+}
+
+// job을 nthreads개의 스레드(현재 스레드 포함)로 끝까지 처리
+static void run_export(export_job *job, const size_t nthreads) {
+  pthread_t threads[BATCH_MAX_THREADS];
+  size_t started = 0;
+  job->next = 0;
+  // 조각은 남은 스레드가 나눠 가져가므로, 만들지 못한 스레드는 건너뛰고 만든 것만 join
+  for (size_t i = 1; i < nthreads; i++) {
+    if (pthread_create(&threads[started], NULL, export_worker, job) == 0) {
+      started++;
+    }
+  }
+  export_worker(job);
+  for (size_t i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
+
+// 트리의 key를 순서대로 arr에 최대 n개 저장
+// 큰 트리는 위쪽 몇 레벨에서 서브트리 조각들로 나누고, 조각 크기의 누적 합으로 각 조각이 쓸 위치를 구한 뒤
+// 여러 스레드가 서로 겹치지 않는 배열 구간을 동시에 채운다.
 int rbtree_to_array(const rbtree *t, key_t *arr, const size_t n) {
-  size_t idx = 0; // 배열에 key를 저장할 현재 인덱스
+  const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  const size_t nthreads = (ncpu > BATCH_MAX_THREADS) ? BATCH_MAX_THREADS : (ncpu > 0 ? (size_t)ncpu : 1);
+  const size_t want = (n < t->count) ? n : t->count;
 
-  // 트리의 루트부터 중위 순회 시작
-  inorder_traverse(t, t->root, arr, n, &idx);
-  
+  if (want < BATCH_PARALLEL_MIN || nthreads < 2) {
+    inorder_traverse(t, t->root, arr, n);  // 트리의 루트부터 중위 순회 시작
+    return 0;
+  }
+
+  // 스레드마다 조각이 4개 이상 돌아가도록 나눌 깊이를 정함
+  int depth = 0;
+  while (((size_t)1 << depth) < 4 * nthreads) {
+    depth++;
+  }
+  export_task *tasks = (export_task *)malloc((((size_t)2 << depth) - 1) * sizeof(export_task));
+  export_job job = {.t = t, .tasks = tasks, .arr = arr, .n = n};
+  collect_tasks(t, t->root, depth, tasks, &job.ntasks);
+
+  // 조각 크기 : 서브트리 크기를 쓸 수 있으면 바로, 아니면 여러 스레드로 세는 단계를 먼저 수행
+#ifndef RBTREE_NO_ORDER_STATS
+  for (size_t i = 0; i < job.ntasks; i++) {
+    tasks[i].count = tasks[i].single ? node_copies(t, tasks[i].root) : tasks[i].root->size;
+  }
+#else
+  job.counting = 1;
+  run_export(&job, nthreads);
+  job.counting = 0;
+#endif
+
+  size_t offset = 0;
+  for (size_t i = 0; i < job.ntasks; i++) {
+    tasks[i].offset = offset;
+    offset += tasks[i].count;
+  }
+  run_export(&job, nthreads);
+
+  free(tasks);
+  return 0;
+}
+
+// 서브트리 x의 black height (x에서 nil까지 경로의 BLACK 노드 수, nil 제외)
+static int black_height(const rbtree *t, const node_t *x) {
+  int h = 0;
+  while (x != t->nil) {
+    if (x->color == RBTREE_BLACK) {
+      h++;
+    }
+    x = x->left;
+  }
+  return h;
+}
+
+// 서브트리를 다루려고 만든 임시 트리 sub에 쌓인 회전과 fixup 횟수를 실제 트리 t의 통계로 옮기는 함수
+static void absorb_stats(rbtree *t, const rbtree *sub) {
+#ifdef RBTREE_STATS
+  STAT_ADD(t, rotations, sub->stats.rotations);
+  STAT_ADD(t, recolors, sub->stats.recolors);
+  STAT_ADD(t, insert_fixup_loops, sub->stats.insert_fixup_loops);
+  STAT_ADD(t, delete_fixup_loops, sub->stats.delete_fixup_loops);
+#else
+  (void)t;
+  (void)sub;
+#endif
+}
+
+// 분리된 두 서브트리 l, r과 노드 k를 하나로 합치는 함수 (l의 key <= k의 key <= r의 key)
+// black height가 큰 쪽의 경계를 따라 내려가 다른 쪽과 black height가 같은 BLACK 노드 c를 찾고,
+// 그 자리에 RED인 k를 놓아 c와 다른 쪽 서브트리를 자식으로 붙인 뒤 insert fixup으로 복구한다.
+// hl, hr은 지금 색 그대로의 l, r의 black height이며, 합쳐진 서브트리의 black height를 *h에 담는다.
+// 경계를 따라 내려가는 길이와 fixup이 올라가는 길이 모두 O(|bh(l) - bh(r)| + 1), 합쳐진 서브트리의 루트를 반환
+static node_t *join_nodes(rbtree *t, node_t *l, int hl, node_t *k, node_t *r, int hr, int *h_out) {
+  rbtree sub = {.nil = t->nil};  // 회전과 fixup이 루트를 갱신할 임시 트리
+
+  // 서브트리의 루트는 BLACK으로 칠해도 RB 속성이 유지됨 (RED였다면 black height가 1 늘어남)
+  if (l != t->nil && l->color == RBTREE_RED) {
+    l->color = RBTREE_BLACK;
+    hl++;
+  }
+  if (r != t->nil && r->color == RBTREE_RED) {
+    r->color = RBTREE_BLACK;
+    hr++;
+  }
+
+  node_t *c, *p = t->nil;
+  int h;
+  if (hl >= hr) {
+    // l의 오른쪽 경계를 따라 black height가 hr인 BLACK 노드를 찾음
+    c = l;
+    h = hl;
+    while (c != t->nil && (c->color == RBTREE_RED || h > hr)) {
+      if (c->color == RBTREE_BLACK) {
+        h--;
+      }
+      p = c;
+      c = c->right;
+    }
+    k->left = c;
+    k->right = r;
+    if (p == t->nil) {
+      sub.root = k;
+    } else {
+      p->right = k;
+      sub.root = l;
+    }
+  } else {
+    // r의 왼쪽 경계를 따라 black height가 hl인 BLACK 노드를 찾음 (대칭)
+    c = r;
+    h = hr;
+    while (c != t->nil && (c->color == RBTREE_RED || h > hl)) {
+      if (c->color == RBTREE_BLACK) {
+        h--;
+      }
+      p = c;
+      c = c->left;
+    }
+    k->left = l;
+    k->right = c;
+    if (p == t->nil) {
+      sub.root = k;
+    } else {
+      p->left = k;
+      sub.root = r;
+    }
+  }
+
+  k->parent = p;
+  k->color = RBTREE_RED;
+  if (k->left != t->nil) {
+    k->left->parent = k;
+  }
+  if (k->right != t->nil) {
+    k->right->parent = k;
+  }
+
+  // k부터 루트까지 서브트리 크기(와 max_hi)를 다시 계산한 뒤 RED-RED 위반을 복구
+  for (node_t *w = k; w != t->nil; w = w->parent) {
+    update_size(w);
+    update_max(w);
+  }
+  *h_out = (hl > hr ? hl : hr) + rbtree_insert_fixup(&sub, k);
+  absorb_stats(t, &sub);
+  return sub.root;
+}
+
+// 분리된 서브트리 x를 key 기준으로 둘로 나누는 함수
+// inclusive가 0이면 key보다 작은 key들을, 1이면 key 이하인 key들을 *l로 보내고 나머지는 *r로 보낸다.
+// hx는 x의 black height이고, 나뉜 두 서브트리의 black height를 *hl, *hr에 담는다.
+// black height를 한 단계마다 줄여 가며 넘기므로 다시 셀 필요가 없고,
+// 경로 위의 join_nodes 비용(black height 차이)이 경로를 따라 상쇄되어 전체가 O(log n)
+static void split_nodes(rbtree *t, node_t *x, const int hx, const key_t key, const int inclusive,
+                        node_t **l, int *hl, node_t **r, int *hr) {
+  if (x == t->nil) {
+    *l = *r = t->nil;
+    *hl = *hr = 0;
+    return;
+  }
+
+  // x의 두 자식을 독립된 서브트리로 떼어냄
+  node_t *xl = x->left;
+  node_t *xr = x->right;
+  if (xl != t->nil) {
+    xl->parent = t->nil;
+  }
+  if (xr != t->nil) {
+    xr->parent = t->nil;
+  }
+
+  // 두 자식의 black height는 같고, x가 BLACK이면 x보다 1 작음
+  const int hc = hx - (x->color == RBTREE_BLACK);
+  node_t *ml, *mr;
+  int hml, hmr;
+  if (inclusive ? (x->key <= key) : (x->key < key)) {
+    // x와 왼쪽 서브트리는 모두 l 쪽, 오른쪽 서브트리만 다시 나눔
+    split_nodes(t, xr, hc, key, inclusive, &ml, &hml, &mr, &hmr);
+    *l = join_nodes(t, xl, hc, x, ml, hml, hl);
+    *r = mr;
+    *hr = hmr;
+  } else {
+    split_nodes(t, xl, hc, key, inclusive, &ml, &hml, &mr, &hmr);
+    *l = ml;
+    *hl = hml;
+    *r = join_nodes(t, mr, hmr, x, xr, hc, hr);
+  }
+}
+
+// 분리된 두 서브트리를 이어 붙이는 함수 (l의 모든 key <= r의 모든 key)
+// r의 최솟값 노드를 떼어내 pivot으로 사용, 두 black height를 세므로 O(log n)
+static node_t *concat_nodes(rbtree *t, node_t *l, node_t *r) {
+  if (r == t->nil) {
+    return l;
+  }
+  if (l == t->nil) {
+    return r;
+  }
+
+  node_t *m = subtree_min(t, r);
+  rbtree sub = {.root = r, .nil = t->nil};
+  unlink_node(&sub, m);
+  absorb_stats(t, &sub);
+  int h;
+  return join_nodes(t, l, black_height(t, l), m, sub.root, black_height(t, sub.root), &h);
+}
+
+// t2의 노드들을 t1으로 옮길 수 있도록 두 트리의 할당자를 맞추는 함수
+// 두 트리가 같은 pool(또는 둘 다 malloc)을 쓰거나, 한쪽이 비어있거나,
+// t2의 pool을 t2 혼자 쓰고 있어 t1의 pool로 흡수할 수 있으면 0, 아니면 -1 반환
+static int share_allocator(rbtree *t1, rbtree *t2) {
+  if (t1->pool == t2->pool || t2->root == t2->nil) {
+    return 0;
+  }
+
+  // t1이 비어있다면 t1이 t2의 할당자를 함께 쓰도록 바꿈
+  if (t1->root == t1->nil) {
+    if (t1->pool != NULL) {
+      pool_release(t1->pool);
+    }
+    t1->pool = t2->pool;
+    if (t1->pool != NULL) {
+      t1->pool->refs++;
+    }
+    return 0;
+  }
+
+  if (t1->pool != NULL && t2->pool != NULL && t2->pool->refs == 1) {
+    pool_absorb(t1->pool, t2->pool);
+    t2->pool = t1->pool;
+    t1->pool->refs++;
+    return 0;
+  }
+  return -1;
+}
+
+// t1 + key + t2를 하나의 트리로 합쳐 t1에 저장하고 t2는 비우는 함수
+// t1의 모든 key <= key <= t2의 모든 key 이어야 하며, O(log n)
+// 순서 조건이나 할당자 조건(share_allocator)을 만족하지 않으면 아무것도 바꾸지 않고 -1 반환
+int rbtree_join(rbtree *t1, const key_t key, rbtree *t2) {
+  if ((t1->root != t1->nil && rbtree_max(t1)->key > key) ||
+      (t2->root != t2->nil && rbtree_min(t2)->key < key)) {
+    return -1;
+  }
+  if (share_allocator(t1, t2) != 0) {
+    return -1;
+  }
+
+  node_t *k = t1->nil;
+#ifdef RBTREE_COUNTED
+  // 한 key는 노드 하나에만 있어야 하므로, 양쪽 끝에 key와 같은 노드가 있으면 떼어내 pivot으로 다시 씀
+  node_t *lmax = rbtree_max(t1);
+  node_t *rmin = rbtree_min(t2);
+  if (lmax != t1->nil && lmax->key == key) {
+    unlink_node(t1, lmax);
+    k = lmax;
+  }
+  if (rmin != t2->nil && rmin->key == key) {
+    unlink_node(t2, rmin);
+    if (k == t1->nil) {
+      k = rmin;
+    } else {
+      k->copies += rmin->copies;
+      node_free(t1, rmin);
+    }
+  }
+  if (k != t1->nil) {
+    k->copies++;
+  }
+#endif
+  if (k == t1->nil) {
+    k = node_new(t1, key);
+  }
+  int h;
+  t1->root = join_nodes(t1, t1->root, black_height(t1, t1->root), k, t2->root, black_height(t2, t2->root), &h);
+  t1->count += t2->count + 1;
+  reset_ends(t1);
+
+  t2->root = t2->nil;
+  t2->count = 0;
+  reset_ends(t2);
+  return 0;
+}
+
+// key 이상인 key들을 새 트리로 옮겨 반환하고, t에는 key보다 작은 key들만 남기는 함수
+// 나누기는 O(log n)이지만, 떼어낸 개수를 세는 데 RBTREE_NO_ORDER_STATS에서는 size가 없어 O(n)이 든다.
+// 새 트리는 따로 pool을 가지며(pool_split), 떼어낸 노드가 남아있는 chunk는 두 트리가 모두 해제될 때 해제된다.
+rbtree *rbtree_split(rbtree *t, const key_t key) {
+  rbtree *r = new_rbtree();
+  if (t->pool != NULL) {
+    r->pool = pool_split(t->pool);
+  }
+
+  node_t *lo, *hi;
+  int hlo, hhi;
+  split_nodes(t, t->root, black_height(t, t->root), key, 0, &lo, &hlo, &hi, &hhi);
+  t->root = lo;
+  r->root = hi;
+
+  // 나뉜 서브트리의 루트는 RED일 수 있으므로 BLACK으로 칠함
+  if (lo != t->nil) {
+    lo->color = RBTREE_BLACK;
+  }
+  if (hi != t->nil) {
+    hi->color = RBTREE_BLACK;
+  }
+  r->count = subtree_count(t, hi);
+  t->count -= r->count;
+  reset_ends(t);
+  reset_ends(r);
+  return r;
+}
+
+typedef enum { SETOP_UNION, SETOP_INTERSECTION, SETOP_DIFFERENCE } setop_t;
+
+// 집합 연산을 여러 스레드로 나눌 때 쓰는 최대 스레드 수
+#define SETOP_MAX_THREADS 8
+// 두 서브트리의 크기 합이 이보다 작으면 스레드를 만들지 않음
+#define SETOP_PARALLEL_MIN 4096
+
+// 서브트리 x의 모든 노드를 dropped 목록(right 포인터로 연결)에 넣는 함수
+// 스레드 안에서는 해제하지 않고 모아두었다가 연산이 끝난 뒤 한꺼번에 반환한다. (pool은 스레드 안전하지 않음)
+static void drop_subtree(const rbtree *t, node_t *x, node_t **dropped) {
+  while (x != t->nil) {
+    node_t *right = x->right;
+    drop_subtree(t, x->left, dropped);
+    x->right = *dropped;
+    *dropped = x;
+    x = right;
+  }
+}
+
+#ifndef RBTREE_COUNTED
+// 같은 key만 들어있는 서브트리 x에서 앞의 keep개만 남기고 나머지는 dropped로 보내는 함수
+static node_t *keep_first(rbtree *t, node_t *x, const size_t keep, node_t **dropped) {
+  const size_t n = subtree_count(t, x);
+  if (keep >= n) {
+    return x;
+  }
+  if (keep == 0) {
+    drop_subtree(t, x, dropped);
+    return t->nil;
+  }
+
+  // 중위 순서로 펼친 뒤 앞부분으로 균형 트리를 다시 만듦
+  rbtree sub = {.root = x, .nil = t->nil};
+  node_t **nodes = (node_t **)malloc(n * sizeof(node_t *));
+  size_t i = 0;
+  for (node_t *p = subtree_min(t, x); p != t->nil; p = rbtree_next(&sub, p)) {
+    nodes[i++] = p;
+  }
+  for (i = keep; i < n; i++) {
+    nodes[i]->right = *dropped;
+    *dropped = nodes[i];
+  }
+  build_tree(&sub, NULL, nodes, keep);
+  free(nodes);
+  return sub.root;
+}
+#endif
+
+typedef struct {
+  rbtree *t;
+  node_t *a, *b;
+  setop_t op;
+  int depth;
+  node_t *result;
+  node_t *dropped;
+} setop_task;
+
+static void *setop_worker(void *arg);
+
+// 분리된 서브트리 a, b에 집합 연산 op를 적용한 결과 서브트리를 반환하는 함수 (multiset 기준)
+// b의 루트 key k로 a와 b를 각각 (< k, == k, > k) 세 부분으로 나누고,
+// < k 와 > k 부분은 재귀적으로 (얕은 깊이에서는 서로 다른 스레드에서) 처리한 뒤
+// == k 부분의 개수를 연산에 맞게 정해서 join으로 이어 붙인다.
+//   union : 개수의 합, intersection : 개수의 최솟값, difference : a 개수 - b 개수 (0 이상)
+static node_t *setop_nodes(rbtree *t, node_t *a, node_t *b, const setop_t op, const int depth, node_t **dropped) {
+  if (a == t->nil) {
+    if (op == SETOP_UNION) {
+      return b;
+    }
+    drop_subtree(t, b, dropped);
+    return t->nil;
+  }
+  if (b == t->nil) {
+    if (op == SETOP_INTERSECTION) {
+      drop_subtree(t, a, dropped);
+      return t->nil;
+    }
+    return a;
+  }
+
+  const key_t k = b->key;
+  node_t *a_lt, *a_ge, *a_eq, *a_gt;
+  node_t *b_lt, *b_ge, *b_eq, *b_gt;
+  int h_lt, h_ge, h_eq, h_gt;
+#ifdef RBTREE_COUNTED
+  const int by_pivot = 0;  // 같은 key는 노드 하나에 모아야 하므로 항상 == k 부분을 따로 떼어냄
+#else
+  const int by_pivot = (op == SETOP_UNION);
+#endif
+  if (by_pivot) {
+    // 합은 같은 key를 어느 쪽에 두어도 되므로 a만 k로 나누고, b의 루트를 그대로 가운데 pivot으로 씀
+    b_lt = b->left;
+    b_gt = b->right;
+    if (b_lt != t->nil) {
+      b_lt->parent = t->nil;
+    }
+    if (b_gt != t->nil) {
+      b_gt->parent = t->nil;
+    }
+    split_nodes(t, a, black_height(t, a), k, 0, &a_lt, &h_lt, &a_gt, &h_gt);
+    a_eq = b_eq = t->nil;
+  } else {
+    split_nodes(t, a, black_height(t, a), k, 0, &a_lt, &h_lt, &a_ge, &h_ge);
+    split_nodes(t, a_ge, h_ge, k, 1, &a_eq, &h_eq, &a_gt, &h_gt);
+    split_nodes(t, b, black_height(t, b), k, 0, &b_lt, &h_lt, &b_ge, &h_ge);
+    split_nodes(t, b_ge, h_ge, k, 1, &b_eq, &h_eq, &b_gt, &h_gt);
+  }
+
+  // depth : 이 아래에서 스레드를 더 나눌 수 있는 단계 수 (한 단계마다 스레드가 두 배)
+  const int child_depth = (depth > 0) ? depth - 1 : 0;
+  node_t *lo, *hi;
+  int spawned = 0;
+  setop_task task = {t, a_lt, b_lt, op, child_depth, t->nil, NULL};
+  pthread_t thread;
+
+  // 충분히 큰 왼쪽 절반은 다른 스레드에서 처리
+  if (depth > 0 && subtree_count(t, a_lt) + subtree_count(t, b_lt) >= SETOP_PARALLEL_MIN) {
+    spawned = pthread_create(&thread, NULL, setop_worker, &task) == 0;
+  }
+  if (!spawned) {
+    task.result = setop_nodes(t, a_lt, b_lt, op, child_depth, dropped);
+  }
+  hi = setop_nodes(t, a_gt, b_gt, op, child_depth, dropped);
+  if (spawned) {
+    pthread_join(thread, NULL);
+    // 스레드가 모은 dropped 목록을 이어 붙임
+    while (task.dropped != NULL) {
+      node_t *next = task.dropped->right;
+      task.dropped->right = *dropped;
+      *dropped = task.dropped;
+      task.dropped = next;
+    }
+  }
+  lo = task.result;
+  if (by_pivot) {
+    int h;
+    return join_nodes(t, lo, black_height(t, lo), b, hi, black_height(t, hi), &h);
+  }
+
+  // == k 부분 : 연산에 따라 남길 개수를 정함
+  const size_t ca = subtree_count(t, a_eq);
+  const size_t cb = subtree_count(t, b_eq);
+  node_t *mid;
+#ifdef RBTREE_COUNTED
+  // key마다 노드가 하나뿐이므로 a_eq, b_eq는 각각 노드 하나 또는 nil, 남길 개수를 노드 하나에 담음
+  const size_t keep = (op == SETOP_UNION) ? ca + cb
+                      : (op == SETOP_INTERSECTION) ? (ca < cb ? ca : cb) : (ca > cb ? ca - cb : 0);
+  mid = (a_eq != t->nil) ? a_eq : b_eq;
+  if (mid != b_eq) {
+    drop_subtree(t, b_eq, dropped);
+  }
+  if (keep == 0) {
+    drop_subtree(t, mid, dropped);
+    mid = t->nil;
+  } else {
+    mid->copies = keep;
+    update_size(mid);
+  }
+#else
+  if (op == SETOP_UNION) {
+    mid = concat_nodes(t, a_eq, b_eq);
+  } else {
+    const size_t keep = (op == SETOP_INTERSECTION) ? (ca < cb ? ca : cb) : (ca > cb ? ca - cb : 0);
+    mid = keep_first(t, a_eq, keep, dropped);
+    drop_subtree(t, b_eq, dropped);
+  }
+#endif
+
+  return concat_nodes(t, concat_nodes(t, lo, mid), hi);
+}
+
+static void *setop_worker(void *arg) {
+  setop_task *task = (setop_task *)arg;
+  task->result = setop_nodes(task->t, task->a, task->b, task->op, task->depth, &task->dropped);
+  return NULL;
+}
+
+// t1과 t2에 집합 연산을 적용해 결과를 t1에 저장하고 t2는 비우는 함수
+// 할당자 조건(share_allocator)을 만족하지 않으면 아무것도 바꾸지 않고 -1 반환
+static int set_operation(rbtree *t1, rbtree *t2, const setop_t op) {
+  if (share_allocator(t1, t2) != 0) {
+    return -1;
+  }
+
+  const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  const long nthreads = (ncpu > SETOP_MAX_THREADS) ? SETOP_MAX_THREADS : ncpu;
+  int depth = 0;
+  while ((1L << depth) < nthreads) {
+    depth++;
+  }
+
+  node_t *dropped = NULL;
+  t1->root = setop_nodes(t1, t1->root, t2->root, op, depth, &dropped);
+  if (t1->root != t1->nil) {
+    t1->root->parent = t1->nil;
+    t1->root->color = RBTREE_BLACK;
+  }
+  t1->count += t2->count;
+  t2->root = t2->nil;
+  t2->count = 0;
+  reset_ends(t2);
+
+  // 결과에서 빠진 노드들을 한꺼번에 반환
+  while (dropped != NULL) {
+    node_t *next = dropped->right;
+    node_free(t1, dropped);
+    t1->count--;
+    dropped = next;
+  }
+#ifdef RBTREE_COUNTED
+  // 남은 노드의 copies를 바꿨으므로 노드 수가 아니라 결과 트리의 key 수로 다시 셈
+  t1->count = subtree_count(t1, t1->root);
+#endif
+  reset_ends(t1);
   return 0;
 }
+
+// t1 = t1 + t2 (multiset 합, 같은 key의 개수를 더함)
+int rbtree_union(rbtree *t1, rbtree *t2) {
+  return set_operation(t1, t2, SETOP_UNION);
+}
+
+// t1 = t1 ∩ t2 (같은 key는 두 트리 중 적은 개수만큼 남김)
+int rbtree_intersection(rbtree *t1, rbtree *t2) {
+  return set_operation(t1, t2, SETOP_INTERSECTION);
+}
+
+// t1 = t1 - t2 (같은 key는 t1의 개수에서 t2의 개수만큼 뺌)
+int rbtree_difference(rbtree *t1, rbtree *t2) {
+  return set_operation(t1, t2, SETOP_DIFFERENCE);
+}
+
+// 서브트리 x의 높이 (가장 긴 경로의 노드 수)
+static int subtree_height(const rbtree *t, const node_t *x) {
+  if (x == t->nil) {
+    return 0;
+  }
+  const int l = subtree_height(t, x->left);
+  const int r = subtree_height(t, x->right);
+  return (l > r ? l : r) + 1;
+}
+
+#ifdef RBTREE_COUNTED
+// 서브트리 x의 노드 수 (key 수와 다름)
+static size_t subtree_nodes(const rbtree *t, const node_t *x) {
+  if (x == t->nil) {
+    return 0;
+  }
+  return subtree_nodes(t, x->left) + subtree_nodes(t, x->right) + 1;
+}
+#endif
+
+// 카운터(RBTREE_STATS로 빌드했을 때만)와 현재 트리 모양을 stats에 채우는 함수
+// 높이를 구하느라 O(n)이므로 연산마다가 아니라 가끔 호출하는 용도
+int rbtree_get_stats(const rbtree *t, rbtree_stats *stats) {
+#ifdef RBTREE_STATS
+  // 다른 스레드가 rbtree_find를 부르는 중일 수 있으므로 카운터는 하나씩 atomic으로 읽음
+  const size_t *src = (const size_t *)&t->stats;
+  size_t *dst = (size_t *)stats;
+  for (size_t i = 0; i < offsetof(rbtree_stats, count) / sizeof(size_t); i++) {
+    dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+  }
+  const int ret = 0;
+#else
+  memset(stats, 0, sizeof(rbtree_stats));
+  const int ret = -1;
+#endif
+  stats->count = t->count;
+  stats->height = subtree_height(t, t->root);
+  stats->black_height = black_height(t, t->root);
+#ifdef RBTREE_COUNTED
+  const size_t nodes = subtree_nodes(t, t->root);
+#else
+  const size_t nodes = t->count;
+#endif
+  stats->bytes_allocated = (t->pool != NULL) ? t->pool->bytes : nodes * sizeof(node_t);
+  return ret;
+}
+
+void rbtree_reset_stats(rbtree *t) {
+#ifdef RBTREE_STATS
+  memset(&t->stats, 0, sizeof(rbtree_stats));
+#else
+  (void)t;
+#endif
+}
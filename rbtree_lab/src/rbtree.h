@@ -7,26 +7,159 @@ typedef enum { RBTREE_RED, RBTREE_BLACK } color_t;
 
 typedef int key_t;
 
+// Built with -DRBTREE_COUNTED, equal keys share one node: rbtree_insert of a
+// key already present bumps copies and returns that node, rbtree_erase drops
+// one occurrence and unlinks the node only at zero. Sizes, select/rank and
+// to_array/range count occurrences; next/prev, cursors and range_foreach step
+// over nodes, i.e. distinct keys.
+//
+// Built with -DRBTREE_INTERVAL, every node holds the closed interval [key, hi]
+// (rbtree_insert stores [key, key]) and max_hi, the largest hi in its subtree,
+// kept up to date by every update and rotation, so overlap queries can skip
+// whole subtrees. One node per interval, hence not with RBTREE_COUNTED.
+#if defined(RBTREE_COUNTED) && defined(RBTREE_INTERVAL)
+#error "RBTREE_INTERVAL needs one node per interval and cannot be combined with RBTREE_COUNTED"
+#endif
 typedef struct node_t {
   color_t color;
   key_t key;
   struct node_t *parent, *left, *right;
+#ifndef RBTREE_NO_ORDER_STATS
+  size_t size;  // number of keys in the subtree rooted here
+#endif
+#ifdef RBTREE_COUNTED
+  size_t copies;  // occurrences of key, every key has exactly one node
+#endif
+#ifdef RBTREE_INTERVAL
+  key_t hi;      // end of the interval [key, hi]
+  key_t max_hi;  // largest hi in the subtree rooted here
+#endif
 } node_t;
 
+typedef struct rbtree_pool rbtree_pool;
+
+#define RBTREE_DEPTH_BUCKETS 64
+
+// Hot-path counters are collected only when built with -DRBTREE_STATS (and
+// compile to nothing otherwise); the shape fields at the end are computed by
+// rbtree_get_stats in every build.
+typedef struct {
+  size_t inserts, erases, finds;
+  size_t rotations;           // left_rotate + right_rotate
+  size_t recolors;            // color writes made by the fixups
+  size_t insert_fixup_loops;  // iterations of rbtree_insert_fixup
+  size_t delete_fixup_loops;  // iterations of rbtree_delete_fixup
+  size_t find_depth[RBTREE_DEPTH_BUCKETS];  // finds by nodes visited, the last bucket is open-ended
+
+  size_t count;
+  int height;              // nodes on the longest root-to-leaf path
+  int black_height;        // black nodes on every root-to-leaf path
+  size_t bytes_allocated;  // node memory held, whole chunks when pooled (a split-off tree counts only its own)
+} rbtree_stats;
+
 typedef struct {
   node_t *root;
   node_t *nil;  // for sentinel
+  node_t *leftmost, *rightmost;  // min and max node, nil if empty; kept by every update
+  rbtree_pool *pool;  // NULL if nodes are malloc'd one by one, see rbtree_split/rbtree_join
+  size_t count;       // number of keys in the tree (occurrences, not nodes, if RBTREE_COUNTED)
+#ifdef RBTREE_STATS
+  rbtree_stats stats;  // counters only, the shape fields are filled in by rbtree_get_stats
+#endif
 } rbtree;
 
+typedef struct {
+  const rbtree *tree;
+  node_t *node;  // current node, tree->nil once the scan runs off either end
+} rbtree_cursor;
+
+// range callback, return non-zero to stop the scan early
+typedef int (*rbtree_visit_fn)(node_t *, void *);
+
+typedef struct {
+  size_t pool_chunk;  // nodes per slab chunk, 0 for plain malloc/free
+} rbtree_config;
+
 rbtree *new_rbtree(void);
+rbtree *new_rbtree_ex(const rbtree_config *);
 void delete_rbtree(rbtree *);
 
+rbtree *rbtree_from_sorted(const key_t *, const size_t);
+// same, with the allocator of config for the nodes added later (NULL for the default)
+rbtree *rbtree_from_sorted_ex(const key_t *, const size_t, const rbtree_config *);
+rbtree *rbtree_from_array(const key_t *, const size_t);
+
 node_t *rbtree_insert(rbtree *, const key_t);
+// inserts next to hint in O(1) comparisons when key belongs there, otherwise
+// like rbtree_insert; the last inserted node is a good hint for sorted input.
+// Updating the subtree sizes up to the root keeps it O(log n) per key unless
+// built with RBTREE_NO_ORDER_STATS, where it is amortized O(1)
+node_t *rbtree_insert_hint(rbtree *, node_t *, const key_t);
+// adds m keys in O(m log(n/m + 1)) by a union with a tree built from the
+// sorted batch, or O(n + m) by relinking everything once m is close to n
+int rbtree_insert_many(rbtree *, const key_t *, const size_t);
 node_t *rbtree_find(const rbtree *, const key_t);
 node_t *rbtree_min(const rbtree *);
 node_t *rbtree_max(const rbtree *);
 int rbtree_erase(rbtree *, node_t *);
+// erase the min (max) node and store its key in *out; 0 if the tree was empty
+int rbtree_pop_min(rbtree *, key_t *);
+int rbtree_pop_max(rbtree *, key_t *);
+// rbtree_erase without the free: returns the node once it is out of the tree,
+// to be released later with rbtree_free_node, or NULL if the node stays
+// (a counted key that still has copies)
+node_t *rbtree_detach(rbtree *, node_t *);
+void rbtree_free_node(rbtree *, node_t *);
+
+size_t rbtree_size(const rbtree *);
+node_t *rbtree_select(const rbtree *, const size_t);
+size_t rbtree_rank(const rbtree *, const key_t);
+
+node_t *rbtree_lower_bound(const rbtree *, const key_t);
+node_t *rbtree_upper_bound(const rbtree *, const key_t);
+size_t rbtree_range(const rbtree *, const key_t, const key_t, key_t *, const size_t);
+size_t rbtree_range_foreach(const rbtree *, const key_t, const key_t, rbtree_visit_fn, void *);
+
+node_t *rbtree_next(const rbtree *, const node_t *);
+node_t *rbtree_prev(const rbtree *, const node_t *);
+
+void rbtree_cursor_first(rbtree_cursor *, const rbtree *);
+void rbtree_cursor_last(rbtree_cursor *, const rbtree *);
+void rbtree_cursor_at(rbtree_cursor *, const rbtree *, node_t *);
+int rbtree_cursor_valid(const rbtree_cursor *);
+void rbtree_cursor_next(rbtree_cursor *);
+void rbtree_cursor_prev(rbtree_cursor *);
 
 int rbtree_to_array(const rbtree *, key_t *, const size_t);
 
+#ifdef RBTREE_INTERVAL
+// adds the interval [lo, hi] (lo <= hi) keyed by lo
+node_t *rbtree_insert_interval(rbtree *, const key_t, const key_t);
+// the interval overlapping [lo, hi] with the smallest start, NULL if none; O(log n)
+node_t *rbtree_interval_overlaps(const rbtree *, const key_t, const key_t);
+// calls fn on every interval overlapping [lo, hi] in start order until it
+// returns non-zero, and returns the number visited; fn must not change the tree
+size_t rbtree_interval_foreach(const rbtree *, const key_t, const key_t, rbtree_visit_fn, void *);
+#endif
+
+// t1 = t1 + key + t2 in O(log n), leaving t2 empty; -1 with nothing changed if
+// some key of t1 > key or some key of t2 < key, or if t2's pool cannot be moved
+// over (a pooled t2 whose pool other trees use, or only one side pooled). The
+// emptied t2 then shares t1's pool, which has no lock: keep both on one thread
+int rbtree_join(rbtree *, const key_t, rbtree *);
+// moves the keys >= key into a new tree; O(log n), but counting the moved keys
+// makes it O(n) under RBTREE_NO_ORDER_STATS. The new tree gets its own pool, so
+// the halves may be used from different threads; its nodes stay in the old
+// chunks, which are freed once both trees are deleted
+rbtree *rbtree_split(rbtree *, const key_t);
+// multiset t1 = t1 op t2 in O(m log(n/m + 1)); t2 ends up empty and sharing t1's pool.
+// -1 with nothing changed if both are non-empty, use different pools, and t2's pool is shared or only one is pooled
+int rbtree_union(rbtree *, rbtree *);
+int rbtree_intersection(rbtree *, rbtree *);
+int rbtree_difference(rbtree *, rbtree *);
+
+// 0 if the counters were collected, -1 if built without RBTREE_STATS (zeroed)
+int rbtree_get_stats(const rbtree *, rbtree_stats *);
+void rbtree_reset_stats(rbtree *);
+
 #endif  // _RBTREE_H_
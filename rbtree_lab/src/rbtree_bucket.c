@@ -0,0 +1,471 @@
+#include "rbtree_bucket.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define B BRB_BUCKET
+// red-black tree의 높이는 2*log2(n+1) 이하이므로 순회 스택은 이만큼이면 충분함
+#define BRB_MAX_HEIGHT 128
+
+// bucket 칸마다 (greater가 0이면 key보다 작은지, 1이면 key보다 큰지)를 비트로 모은 mask
+// 사용하지 않는 칸도 함께 비교하므로 호출하는 쪽에서 앞의 n비트만 남긴다.
+static unsigned compare_mask(const key_t *k, const key_t key, const int greater) {
+#if defined(__AVX2__)
+  const __m256i x = _mm256_set1_epi32(key);
+  const __m256i lo = _mm256_loadu_si256((const __m256i *)k);
+  const __m256i hi = _mm256_loadu_si256((const __m256i *)(k + 8));
+  const __m256i mlo = greater ? _mm256_cmpgt_epi32(lo, x) : _mm256_cmpgt_epi32(x, lo);
+  const __m256i mhi = greater ? _mm256_cmpgt_epi32(hi, x) : _mm256_cmpgt_epi32(x, hi);
+  return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(mlo)) |
+         (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(mhi)) << 8;
+#elif defined(__SSE2__)
+  const __m128i x = _mm_set1_epi32(key);
+  unsigned mask = 0;
+  for (int i = 0; i < B / 4; i++) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(k + 4 * i));
+    const __m128i m = greater ? _mm_cmpgt_epi32(v, x) : _mm_cmpgt_epi32(x, v);
+    mask |= (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m)) << (4 * i);
+  }
+  return mask;
+#else
+  unsigned mask = 0;
+  for (int i = 0; i < B; i++) {
+    mask |= (unsigned)(greater ? k[i] > key : k[i] < key) << i;
+  }
+  return mask;
+#endif
+}
+
+// bucket x에서 key보다 작은 key의 수 = key 이상인 첫 칸의 위치
+static unsigned count_less(const brb_node *x, const key_t key) {
+  return (unsigned)__builtin_popcount(compare_mask(x->keys, key, 0) & ((1u << x->n) - 1));
+}
+
+// bucket x에서 key 이하인 key의 수 = key보다 큰 첫 칸의 위치
+static unsigned count_not_greater(const brb_node *x, const key_t key) {
+  return x->n - (unsigned)__builtin_popcount(compare_mask(x->keys, key, 1) & ((1u << x->n) - 1));
+}
+
+// 빈 bucket 노드 하나를 할당 (모든 칸을 0으로 채워 두므로 SIMD 비교가 초기화되지 않은 값을 읽지 않음)
+static brb_node *node_new(brbtree *t) {
+  brb_node *x = (brb_node *)calloc(1, sizeof(brb_node));
+  x->parent = x->left = x->right = &t->nil;
+  x->color = RBTREE_RED;
+  t->nodes++;
+  return x;
+}
+
+brbtree *new_brbtree(void) {
+  brbtree *t = (brbtree *)calloc(1, sizeof(brbtree));
+  t->nil.color = RBTREE_BLACK;
+  t->nil.parent = t->nil.left = t->nil.right = &t->nil;
+  t->root = &t->nil;
+  return t;
+}
+
+static void delete_nodes(brbtree *t, brb_node *x) {
+  // 왼쪽은 반복으로 내려가고 오른쪽만 재귀
+  while (x != &t->nil) {
+    brb_node *left = x->left;
+    delete_nodes(t, x->right);
+    free(x);
+    x = left;
+  }
+}
+
+void delete_brbtree(brbtree *t) {
+  delete_nodes(t, t->root);
+  free(t);
+}
+
+static void left_rotate(brbtree *t, brb_node *x) {
+  brb_node *y = x->right;
+  x->right = y->left;
+  if (y->left != &t->nil) {
+    y->left->parent = x;
+  }
+  y->parent = x->parent;
+  if (x->parent == &t->nil) {
+    t->root = y;
+  } else if (x == x->parent->left) {
+    x->parent->left = y;
+  } else {
+    x->parent->right = y;
+  }
+  y->left = x;
+  x->parent = y;
+}
+
+static void right_rotate(brbtree *t, brb_node *x) {
+  brb_node *y = x->left;
+  x->left = y->right;
+  if (y->right != &t->nil) {
+    y->right->parent = x;
+  }
+  y->parent = x->parent;
+  if (x->parent == &t->nil) {
+    t->root = y;
+  } else if (x == x->parent->right) {
+    x->parent->right = y;
+  } else {
+    x->parent->left = y;
+  }
+  y->right = x;
+  x->parent = y;
+}
+
+static void insert_fixup(brbtree *t, brb_node *z) {
+  while (z->parent->color == RBTREE_RED) {
+    brb_node *g = z->parent->parent;
+    if (z->parent == g->left) {
+      brb_node *u = g->right;
+      if (u->color == RBTREE_RED) {
+        z->parent->color = RBTREE_BLACK;
+        u->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        z = g;
+      } else {
+        if (z == z->parent->right) {
+          z = z->parent;
+          left_rotate(t, z);
+        }
+        z->parent->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        right_rotate(t, g);
+      }
+    } else {
+      brb_node *u = g->left;
+      if (u->color == RBTREE_RED) {
+        z->parent->color = RBTREE_BLACK;
+        u->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        z = g;
+      } else {
+        if (z == z->parent->left) {
+          z = z->parent;
+          right_rotate(t, z);
+        }
+        z->parent->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        left_rotate(t, g);
+      }
+    }
+  }
+  t->root->color = RBTREE_BLACK;
+}
+
+// 트리에서 u 자리를 v로 교체 (nil은 트리마다 따로 있으므로 v가 nil이어도 parent를 기록함)
+static void transplant(brbtree *t, brb_node *u, brb_node *v) {
+  if (u->parent == &t->nil) {
+    t->root = v;
+  } else if (u == u->parent->left) {
+    u->parent->left = v;
+  } else {
+    u->parent->right = v;
+  }
+  v->parent = u->parent;
+}
+
+static void delete_fixup(brbtree *t, brb_node *x) {
+  while (x != t->root && x->color == RBTREE_BLACK) {
+    if (x == x->parent->left) {
+      brb_node *w = x->parent->right;
+      if (w->color == RBTREE_RED) {
+        w->color = RBTREE_BLACK;
+        x->parent->color = RBTREE_RED;
+        left_rotate(t, x->parent);
+        w = x->parent->right;
+      }
+      if (w->left->color == RBTREE_BLACK && w->right->color == RBTREE_BLACK) {
+        w->color = RBTREE_RED;
+        x = x->parent;
+      } else {
+        if (w->right->color == RBTREE_BLACK) {
+          w->left->color = RBTREE_BLACK;
+          w->color = RBTREE_RED;
+          right_rotate(t, w);
+          w = x->parent->right;
+        }
+        w->color = x->parent->color;
+        x->parent->color = RBTREE_BLACK;
+        w->right->color = RBTREE_BLACK;
+        left_rotate(t, x->parent);
+        x = t->root;
+      }
+    } else {
+      brb_node *w = x->parent->left;
+      if (w->color == RBTREE_RED) {
+        w->color = RBTREE_BLACK;
+        x->parent->color = RBTREE_RED;
+        right_rotate(t, x->parent);
+        w = x->parent->left;
+      }
+      if (w->right->color == RBTREE_BLACK && w->left->color == RBTREE_BLACK) {
+        w->color = RBTREE_RED;
+        x = x->parent;
+      } else {
+        if (w->left->color == RBTREE_BLACK) {
+          w->right->color = RBTREE_BLACK;
+          w->color = RBTREE_RED;
+          left_rotate(t, w);
+          w = x->parent->left;
+        }
+        w->color = x->parent->color;
+        x->parent->color = RBTREE_BLACK;
+        w->left->color = RBTREE_BLACK;
+        right_rotate(t, x->parent);
+        x = t->root;
+      }
+    }
+  }
+  x->color = RBTREE_BLACK;
+}
+
+// 노드 z를 트리에서 떼어내고 해제 (CLRS RB-DELETE)
+static void remove_node(brbtree *t, brb_node *z) {
+  brb_node *y = z;
+  brb_node *x;
+  color_t y_original_color = y->color;
+
+  if (z->left == &t->nil) {
+    x = z->right;
+    transplant(t, z, z->right);
+  } else if (z->right == &t->nil) {
+    x = z->left;
+    transplant(t, z, z->left);
+  } else {
+    y = z->right;
+    while (y->left != &t->nil) {
+      y = y->left;
+    }
+    y_original_color = y->color;
+    x = y->right;
+    if (y->parent == z) {
+      x->parent = y;
+    } else {
+      transplant(t, y, y->right);
+      y->right = z->right;
+      y->right->parent = y;
+    }
+    transplant(t, z, y);
+    y->left = z->left;
+    y->left->parent = y;
+    y->color = z->color;
+  }
+  if (y_original_color == RBTREE_BLACK) {
+    delete_fixup(t, x);
+  }
+  free(z);
+  t->nodes--;
+}
+
+static brb_node *next_node(const brbtree *t, brb_node *x) {
+  if (x->right != &t->nil) {
+    x = x->right;
+    while (x->left != &t->nil) {
+      x = x->left;
+    }
+    return x;
+  }
+  brb_node *y = x->parent;
+  while (y != &t->nil && x == y->right) {
+    x = y;
+    y = y->parent;
+  }
+  return y;
+}
+
+static brb_node *prev_node(const brbtree *t, brb_node *x) {
+  if (x->left != &t->nil) {
+    x = x->left;
+    while (x->right != &t->nil) {
+      x = x->right;
+    }
+    return x;
+  }
+  brb_node *y = x->parent;
+  while (y != &t->nil && x == y->left) {
+    x = y;
+    y = y->parent;
+  }
+  return y;
+}
+
+// 가득 찬 bucket x의 pos 위치에 key를 넣으며 둘로 나누는 함수
+// 뒤쪽 절반은 새 노드 y로 옮기고, y를 x의 바로 다음 노드 자리(x의 오른쪽 서브트리의 가장 왼쪽)에 붙인다.
+// 맨 뒤에 붙는 key(오름차순 입력)면 x를 꽉 찬 채로 두고 새 key만 y로 보내 bucket이 반만 차는 것을 막는다.
+static void split_insert(brbtree *t, brb_node *x, const unsigned pos, const key_t key) {
+  brb_node *y = node_new(t);
+  if (pos == B) {
+    y->keys[0] = key;
+    y->n = 1;
+  } else {
+    key_t all[B + 1];
+    memcpy(all, x->keys, pos * sizeof(key_t));
+    all[pos] = key;
+    memcpy(all + pos + 1, x->keys + pos, (B - pos) * sizeof(key_t));
+    const unsigned half = (B + 1) / 2;
+    memcpy(x->keys, all, half * sizeof(key_t));
+    x->n = half;
+    memcpy(y->keys, all + half, (B + 1 - half) * sizeof(key_t));
+    y->n = B + 1 - half;
+  }
+
+  if (x->right == &t->nil) {
+    x->right = y;
+    y->parent = x;
+  } else {
+    brb_node *s = x->right;
+    while (s->left != &t->nil) {
+      s = s->left;
+    }
+    s->left = y;
+    y->parent = s;
+  }
+  insert_fixup(t, y);
+}
+
+int brbtree_insert(brbtree *t, const key_t key) {
+  t->count++;
+  if (t->root == &t->nil) {
+    brb_node *x = node_new(t);
+    x->keys[0] = key;
+    x->n = 1;
+    x->color = RBTREE_BLACK;
+    t->root = x;
+    return 0;
+  }
+
+  // key가 범위 안에 들어가는 bucket, 없으면 key가 들어갈 틈에 맞닿은 bucket을 찾음
+  brb_node *x = t->root;
+  for (;;) {
+    if (key < x->keys[0] && x->left != &t->nil) {
+      x = x->left;
+    } else if (key > x->keys[x->n - 1] && x->right != &t->nil) {
+      x = x->right;
+    } else {
+      break;
+    }
+  }
+
+  const unsigned pos = count_not_greater(x, key);  // 같은 key들 뒤에 넣음
+  if (x->n < B) {
+    memmove(x->keys + pos + 1, x->keys + pos, (x->n - pos) * sizeof(key_t));
+    x->keys[pos] = key;
+    x->n++;
+  } else {
+    split_insert(t, x, pos, key);
+  }
+  return 0;
+}
+
+// key를 담고 있는 bucket을 찾아 *idx에 위치를 기록, 없으면 nil
+static brb_node *find_bucket(const brbtree *t, const key_t key, unsigned *idx) {
+  brb_node *x = t->root;
+  while (x != &t->nil) {
+    if (key < x->keys[0]) {
+      x = x->left;
+    } else if (key > x->keys[x->n - 1]) {
+      x = x->right;
+    } else {
+      // 범위 안에 없으면 다른 bucket에도 없음 (이웃 bucket의 key는 모두 이 범위 밖)
+      const unsigned i = count_less(x, key);
+      if (x->keys[i] != key) {
+        return (brb_node *)&t->nil;
+      }
+      *idx = i;
+      return x;
+    }
+  }
+  return x;
+}
+
+const key_t *brbtree_find(const brbtree *t, const key_t key) {
+  unsigned i;
+  brb_node *x = find_bucket(t, key, &i);
+  return (x != &t->nil) ? &x->keys[i] : NULL;
+}
+
+const key_t *brbtree_min(const brbtree *t) {
+  brb_node *x = t->root;
+  if (x == &t->nil) {
+    return NULL;
+  }
+  while (x->left != &t->nil) {
+    x = x->left;
+  }
+  return &x->keys[0];
+}
+
+const key_t *brbtree_max(const brbtree *t) {
+  brb_node *x = t->root;
+  if (x == &t->nil) {
+    return NULL;
+  }
+  while (x->right != &t->nil) {
+    x = x->right;
+  }
+  return &x->keys[x->n - 1];
+}
+
+// key 하나를 지우고, bucket이 비면 노드를 떼어내며, 1/4 이하로 줄면 여유가 있는 이웃 bucket에 합친다.
+int brbtree_erase(brbtree *t, const key_t key) {
+  unsigned i;
+  brb_node *x = find_bucket(t, key, &i);
+  if (x == &t->nil) {
+    return 0;
+  }
+  memmove(x->keys + i, x->keys + i + 1, (x->n - i - 1) * sizeof(key_t));
+  x->n--;
+  t->count--;
+
+  if (x->n == 0) {
+    remove_node(t, x);
+  } else if (x->n <= B / 4) {
+    brb_node *s = next_node(t, x);
+    brb_node *p = prev_node(t, x);
+    if (s != &t->nil && s->n + x->n <= B) {
+      // x의 key는 모두 s의 key 이하이므로 s의 앞에 붙임
+      memmove(s->keys + x->n, s->keys, s->n * sizeof(key_t));
+      memcpy(s->keys, x->keys, x->n * sizeof(key_t));
+      s->n += x->n;
+      remove_node(t, x);
+    } else if (p != &t->nil && p->n + x->n <= B) {
+      memcpy(p->keys + p->n, x->keys, x->n * sizeof(key_t));
+      p->n += x->n;
+      remove_node(t, x);
+    }
+  }
+  return 1;
+}
+
+size_t brbtree_size(const brbtree *t) {
+  return t->count;
+}
+
+// bucket들을 중위 순서로 돌며 key를 arr에 최대 n개 저장
+int brbtree_to_array(const brbtree *t, key_t *arr, const size_t n) {
+  brb_node *stack[BRB_MAX_HEIGHT];
+  int top = 0;
+  size_t idx = 0;
+  brb_node *x = t->root;
+  while (idx < n) {
+    while (x != &t->nil) {
+      stack[top++] = x;
+      x = x->left;
+    }
+    if (top == 0) {
+      break;
+    }
+    x = stack[--top];
+    const size_t c = (x->n < n - idx) ? x->n : n - idx;
+    memcpy(arr + idx, x->keys, c * sizeof(key_t));
+    idx += c;
+    x = x->right;
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef _RBTREE_BUCKET_H_
+#define _RBTREE_BUCKET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// Fat-leaf red-black tree: every node holds a sorted bucket of up to
+// BRB_BUCKET keys, and the buckets are ordered so that each one's keys are
+// <= the next one's. A full bucket splits in two, and a bucket that drops to
+// a quarter full is merged into a neighbour with room, so the tree has about
+// n / 10 nodes and each step of a descent compares a whole bucket (with SIMD
+// when available) instead of one key. Keys move between buckets, so lookups
+// hand back a pointer to a key that stays valid only until the next update.
+#define BRB_BUCKET 16
+
+typedef struct brb_node {
+  key_t keys[BRB_BUCKET];  // keys[0, n) in order
+  uint32_t n;
+  color_t color;
+  struct brb_node *parent, *left, *right;
+} brb_node;  // 96 bytes
+
+typedef struct {
+  brb_node *root;
+  brb_node nil;  // sentinel, lives inside the tree like the RBTREE_DEFINE maps
+  size_t count;  // number of keys
+  size_t nodes;  // number of buckets
+} brbtree;
+
+brbtree *new_brbtree(void);
+void delete_brbtree(brbtree *);
+
+int brbtree_insert(brbtree *, const key_t);
+const key_t *brbtree_find(const brbtree *, const key_t);
+const key_t *brbtree_min(const brbtree *);
+const key_t *brbtree_max(const brbtree *);
+int brbtree_erase(brbtree *, const key_t);  // removes one copy, 1 if found
+
+size_t brbtree_size(const brbtree *);
+int brbtree_to_array(const brbtree *, key_t *, const size_t);
+
+#endif  // _RBTREE_BUCKET_H_
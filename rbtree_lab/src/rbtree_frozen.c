@@ -0,0 +1,148 @@
+#include "rbtree_frozen.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define B RBTREE_FROZEN_BLOCK
+// 빈 칸을 채우는 값 : 모든 key 이상이므로 빈 칸은 key 순서상 항상 맨 뒤에 온다. (key_t가 int)
+#define FROZEN_PAD INT_MAX
+
+// block k의 i번째 자식 block 번호 (0 <= i <= B)
+static size_t child(const size_t k, const size_t i) {
+  return k * (B + 1) + i + 1;
+}
+
+// 정렬된 block b에서 key보다 작은 key의 수 = key 이상인 첫 칸의 위치 (없으면 B)
+// 분기 없이 block 전체를 한 번에 비교한다.
+static unsigned block_rank(const key_t *b, const key_t key) {
+#if defined(__AVX2__)
+  const __m256i x = _mm256_set1_epi32(key);
+  const __m256i lo = _mm256_cmpgt_epi32(x, _mm256_load_si256((const __m256i *)b));
+  const __m256i hi = _mm256_cmpgt_epi32(x, _mm256_load_si256((const __m256i *)(b + 8)));
+  const unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(lo)) |
+                        (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8;
+  return (unsigned)__builtin_popcount(mask);
+#elif defined(__SSE2__)
+  const __m128i x = _mm_set1_epi32(key);
+  unsigned mask = 0;
+  for (int i = 0; i < B / 4; i++) {
+    const __m128i lt = _mm_cmpgt_epi32(x, _mm_load_si128((const __m128i *)(b + 4 * i)));
+    mask |= (unsigned)_mm_movemask_ps(_mm_castsi128_ps(lt)) << (4 * i);
+  }
+  return (unsigned)__builtin_popcount(mask);
+#else
+  unsigned r = 0;
+  for (int i = 0; i < B; i++) {
+    r += b[i] < key;
+  }
+  return r;
+#endif
+}
+
+// block k를 root로 하는 서브트리의 칸들을 key 순서(중위 순서)대로 keys로 채우는 함수
+// 자식 0, 칸 0, 자식 1, 칸 1, ..., 칸 B-1, 자식 B 순서로 방문한다.
+static void fill(rbtree_frozen *f, const key_t *keys, const size_t k, size_t *next) {
+  if (k >= f->nblocks) {
+    return;
+  }
+  for (size_t i = 0; i < B; i++) {
+    fill(f, keys, child(k, i), next);
+    key_t *slot = &f->blocks[k * B + i];
+    if (*next < f->count) {
+      *slot = keys[*next];
+      if (*next == 0) {
+        f->min = slot;
+      }
+      if (*next == f->count - 1) {
+        f->max = slot;
+      }
+    } else {
+      *slot = FROZEN_PAD;
+    }
+    (*next)++;
+  }
+  fill(f, keys, child(k, B), next);
+}
+
+// 트리의 key들로 읽기 전용 구조를 만들어 반환 (트리는 바꾸지 않으며 이후 따로 해제해도 됨)
+rbtree_frozen *rbtree_freeze(const rbtree *t) {
+  rbtree_frozen *f = (rbtree_frozen *)calloc(1, sizeof(rbtree_frozen));
+  f->count = rbtree_size(t);
+  f->nblocks = (f->count + B - 1) / B;
+  if (f->count == 0) {
+    return f;
+  }
+
+  key_t *keys = (key_t *)malloc(f->count * sizeof(key_t));
+  rbtree_to_array(t, keys, f->count);
+  f->blocks = (key_t *)aligned_alloc(64, f->nblocks * B * sizeof(key_t));
+  size_t next = 0;
+  fill(f, keys, 0, &next);
+  free(keys);
+  return f;
+}
+
+void delete_rbtree_frozen(rbtree_frozen *f) {
+  free(f->blocks);
+  free(f);
+}
+
+size_t rbtree_frozen_size(const rbtree_frozen *f) {
+  return f->count;
+}
+
+// key 이상인 첫 key를 반환, 없으면 NULL
+// 층마다 block 하나를 읽고, 그 안의 위치로 후보와 다음 block을 분기 없이 정한다.
+const key_t *rbtree_frozen_lower_bound(const rbtree_frozen *f, const key_t key) {
+  if (f->count == 0 || key > *f->max) {
+    return NULL;  // 빈 칸(FROZEN_PAD)에 닿지 않도록 최댓값보다 큰 key는 먼저 거름
+  }
+  const key_t *res = NULL;
+  size_t k = 0;
+  while (k < f->nblocks) {
+    const key_t *b = f->blocks + k * B;
+    const unsigned i = block_rank(b, key);
+    res = (i < B) ? b + i : res;
+    k = child(k, i);
+  }
+  return res;
+}
+
+// key와 같은 key를 반환, 없으면 NULL
+const key_t *rbtree_frozen_find(const rbtree_frozen *f, const key_t key) {
+  const key_t *p = rbtree_frozen_lower_bound(f, key);
+  return (p != NULL && *p == key) ? p : NULL;
+}
+
+const key_t *rbtree_frozen_min(const rbtree_frozen *f) {
+  return f->min;
+}
+
+const key_t *rbtree_frozen_max(const rbtree_frozen *f) {
+  return f->max;
+}
+
+// block k의 서브트리를 key 순서대로 arr에 최대 n개 저장
+static void export_block(const rbtree_frozen *f, const size_t k, key_t *arr, const size_t n, size_t *idx) {
+  if (k >= f->nblocks) {
+    return;
+  }
+  for (size_t i = 0; i < B && *idx < n; i++) {
+    export_block(f, child(k, i), arr, n, idx);
+    if (*idx < n) {
+      arr[(*idx)++] = f->blocks[k * B + i];
+    }
+  }
+  export_block(f, child(k, B), arr, n, idx);
+}
+
+// key를 순서대로 arr에 최대 n개 저장하고 저장한 수를 반환
+size_t rbtree_frozen_to_array(const rbtree_frozen *f, key_t *arr, const size_t n) {
+  size_t idx = 0;
+  export_block(f, 0, arr, n < f->count ? n : f->count, &idx);
+  return idx;
+}
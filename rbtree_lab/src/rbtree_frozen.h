@@ -0,0 +1,33 @@
+#ifndef _RBTREE_FROZEN_H_
+#define _RBTREE_FROZEN_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// Immutable, read-only copy of a tree laid out as a static B-tree. Keys are
+// packed RBTREE_FROZEN_BLOCK to a 64-byte block and the children of block k
+// are blocks k * (RBTREE_FROZEN_BLOCK + 1) + 1 + i, so a lookup reads one
+// cache line per level and ranks the key against a whole block with a few
+// SIMD compares (SSE2, or AVX2 when built with -mavx2) instead of chasing
+// node pointers. Returned pointers stay valid until delete_rbtree_frozen.
+#define RBTREE_FROZEN_BLOCK 16
+
+typedef struct {
+  key_t *blocks;     // nblocks * RBTREE_FROZEN_BLOCK keys, 64-byte aligned
+  size_t nblocks;
+  size_t count;      // number of keys, the slots after them in key order are padding
+  const key_t *min, *max;  // NULL if empty
+} rbtree_frozen;
+
+rbtree_frozen *rbtree_freeze(const rbtree *);
+void delete_rbtree_frozen(rbtree_frozen *);
+
+size_t rbtree_frozen_size(const rbtree_frozen *);
+const key_t *rbtree_frozen_find(const rbtree_frozen *, const key_t);
+const key_t *rbtree_frozen_lower_bound(const rbtree_frozen *, const key_t);
+const key_t *rbtree_frozen_min(const rbtree_frozen *);
+const key_t *rbtree_frozen_max(const rbtree_frozen *);
+size_t rbtree_frozen_to_array(const rbtree_frozen *, key_t *, const size_t);
+
+#endif  // _RBTREE_FROZEN_H_
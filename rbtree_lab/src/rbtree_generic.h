@@ -0,0 +1,375 @@
+#ifndef _RBTREE_GENERIC_H_
+#define _RBTREE_GENERIC_H_
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "rbtree.h"
+
+// Typed red-black tree generator.
+//
+//   RBTREE_DEFINE(name, K, V, cmp)
+//
+// stamps out a tree type `name` with nodes `name##_node` carrying a key of
+// type K and a value of type V, plus static inline operations new_##name,
+// delete_##name, name##_insert, name##_set, name##_find, name##_erase,
+// name##_min, name##_max, name##_next, name##_prev, name##_lower_bound,
+// name##_size and name##_to_array. Lookups that miss return NULL.
+//
+// cmp(a, b) must return <0, 0 or >0. It is expanded directly inside the
+// descents, so a macro or a static inline function is inlined there instead
+// of being called through a function pointer.
+
+// Comparator for any type with the built-in < and > operators.
+#define RBTREE_CMP_NATIVE(a, b) (((a) > (b)) - ((a) < (b)))
+
+#define RBTREE_DEFINE(name, K, V, cmp)                                                 \
+typedef struct name##_node {                                                           \
+  K key;                                                                               \
+  V value;                                                                             \
+  struct name##_node *parent, *left, *right;                                           \
+  color_t color;                                                                       \
+} name##_node;                                                                         \
+                                                                                       \
+typedef struct {                                                                       \
+  name##_node *root;                                                                   \
+  name##_node nil; /* sentinel, lives inside the tree so it never moves */             \
+  size_t count;                                                                        \
+} name;                                                                                \
+                                                                                       \
+static inline name *new_##name(void) {                                                 \
+  name *t = (name *)calloc(1, sizeof(name));                                           \
+  t->nil.color = RBTREE_BLACK;                                                         \
+  t->nil.parent = t->nil.left = t->nil.right = &t->nil;                                \
+  t->root = &t->nil;                                                                   \
+  return t;                                                                            \
+}                                                                                      \
+                                                                                       \
+static inline void name##_delete_nodes(name *t, name##_node *x) {                      \
+  /* descend left iteratively, recurse only on right children */                       \
+  while (x != &t->nil) {                                                               \
+    name##_node *left = x->left;                                                       \
+    name##_delete_nodes(t, x->right);                                                  \
+    free(x);                                                                           \
+    x = left;                                                                          \
+  }                                                                                    \
+}                                                                                      \
+                                                                                       \
+static inline void delete_##name(name *t) {                                            \
+  name##_delete_nodes(t, t->root);                                                     \
+  free(t);                                                                             \
+}                                                                                      \
+                                                                                       \
+static inline void name##_left_rotate(name *t, name##_node *x) {                       \
+  name##_node *y = x->right;                                                           \
+  x->right = y->left;                                                                  \
+  if (y->left != &t->nil) {                                                            \
+    y->left->parent = x;                                                               \
+  }                                                                                    \
+  y->parent = x->parent;                                                               \
+  if (x->parent == &t->nil) {                                                          \
+    t->root = y;                                                                       \
+  } else if (x == x->parent->left) {                                                   \
+    x->parent->left = y;                                                               \
+  } else {                                                                             \
+    x->parent->right = y;                                                              \
+  }                                                                                    \
+  y->left = x;                                                                         \
+  x->parent = y;                                                                       \
+}                                                                                      \
+                                                                                       \
+static inline void name##_right_rotate(name *t, name##_node *x) {                      \
+  name##_node *y = x->left;                                                            \
+  x->left = y->right;                                                                  \
+  if (y->right != &t->nil) {                                                           \
+    y->right->parent = x;                                                              \
+  }                                                                                    \
+  y->parent = x->parent;                                                               \
+  if (x->parent == &t->nil) {                                                          \
+    t->root = y;                                                                       \
+  } else if (x == x->parent->right) {                                                  \
+    x->parent->right = y;                                                              \
+  } else {                                                                             \
+    x->parent->left = y;                                                               \
+  }                                                                                    \
+  y->right = x;                                                                        \
+  x->parent = y;                                                                       \
+}                                                                                      \
+                                                                                       \
+static inline void name##_insert_fixup(name *t, name##_node *z) {                      \
+  while (z->parent->color == RBTREE_RED) {                                             \
+    name##_node *g = z->parent->parent;                                                \
+    if (z->parent == g->left) {                                                        \
+      name##_node *uncle = g->right;                                                   \
+      if (uncle->color == RBTREE_RED) {                                                \
+        z->parent->color = RBTREE_BLACK;                                               \
+        uncle->color = RBTREE_BLACK;                                                   \
+        g->color = RBTREE_RED;                                                         \
+        z = g;                                                                         \
+      } else {                                                                         \
+        if (z == z->parent->right) {                                                   \
+          z = z->parent;                                                               \
+          name##_left_rotate(t, z);                                                    \
+        }                                                                              \
+        z->parent->color = RBTREE_BLACK;                                               \
+        z->parent->parent->color = RBTREE_RED;                                         \
+        name##_right_rotate(t, z->parent->parent);                                     \
+      }                                                                                \
+    } else {                                                                           \
+      name##_node *uncle = g->left;                                                    \
+      if (uncle->color == RBTREE_RED) {                                                \
+        z->parent->color = RBTREE_BLACK;                                               \
+        uncle->color = RBTREE_BLACK;                                                   \
+        g->color = RBTREE_RED;                                                         \
+        z = g;                                                                         \
+      } else {                                                                         \
+        if (z == z->parent->left) {                                                    \
+          z = z->parent;                                                               \
+          name##_right_rotate(t, z);                                                   \
+        }                                                                              \
+        z->parent->color = RBTREE_BLACK;                                               \
+        z->parent->parent->color = RBTREE_RED;                                         \
+        name##_left_rotate(t, z->parent->parent);                                      \
+      }                                                                                \
+    }                                                                                  \
+  }                                                                                    \
+  t->root->color = RBTREE_BLACK;                                                       \
+}                                                                                      \
+                                                                                       \
+/* multiset insert: equal keys go to the right, like rbtree_insert */                  \
+static inline name##_node *name##_insert(name *t, const K key, const V value) {        \
+  name##_node *y = &t->nil;                                                            \
+  name##_node *x = t->root;                                                            \
+  name##_node *z = (name##_node *)malloc(sizeof(name##_node));                         \
+  z->key = key;                                                                        \
+  z->value = value;                                                                    \
+                                                                                       \
+  while (x != &t->nil) {                                                               \
+    y = x;                                                                             \
+    x = (cmp(key, x->key) < 0) ? x->left : x->right;                                   \
+  }                                                                                    \
+  z->parent = y;                                                                       \
+  if (y == &t->nil) {                                                                  \
+    t->root = z;                                                                       \
+  } else if (cmp(key, y->key) < 0) {                                                   \
+    y->left = z;                                                                       \
+  } else {                                                                             \
+    y->right = z;                                                                      \
+  }                                                                                    \
+  z->left = z->right = &t->nil;                                                        \
+  z->color = RBTREE_RED;                                                               \
+  name##_insert_fixup(t, z);                                                           \
+  t->count++;                                                                          \
+  return z;                                                                            \
+}                                                                                      \
+                                                                                       \
+/* node holding key, or NULL */                                                        \
+static inline name##_node *name##_find(const name *t, const K key) {                   \
+  name##_node *x = t->root;                                                            \
+  while (x != &t->nil) {                                                               \
+    const int c = cmp(key, x->key);                                                    \
+    if (c == 0) {                                                                      \
+      return x;                                                                        \
+    }                                                                                  \
+    x = (c < 0) ? x->left : x->right;                                                  \
+  }                                                                                    \
+  return NULL;                                                                         \
+}                                                                                      \
+                                                                                       \
+/* map insert: overwrite the value of an existing key, otherwise insert */             \
+static inline name##_node *name##_set(name *t, const K key, const V value) {           \
+  name##_node *x = name##_find(t, key);                                                \
+  if (x != NULL) {                                                                     \
+    x->value = value;                                                                  \
+    return x;                                                                          \
+  }                                                                                    \
+  return name##_insert(t, key, value);                                                 \
+}                                                                                      \
+                                                                                       \
+/* first node with key >= key, or NULL */                                              \
+static inline name##_node *name##_lower_bound(const name *t, const K key) {            \
+  name##_node *x = t->root;                                                            \
+  name##_node *candidate = NULL;                                                       \
+  while (x != &t->nil) {                                                               \
+    if (cmp(x->key, key) >= 0) {                                                       \
+      candidate = x;                                                                   \
+      x = x->left;                                                                     \
+    } else {                                                                           \
+      x = x->right;                                                                    \
+    }                                                                                  \
+  }                                                                                    \
+  return candidate;                                                                    \
+}                                                                                      \
+                                                                                       \
+static inline name##_node *name##_min(const name *t) {                                 \
+  name##_node *x = t->root;                                                            \
+  if (x == &t->nil) {                                                                  \
+    return NULL;                                                                       \
+  }                                                                                    \
+  while (x->left != &t->nil) {                                                         \
+    x = x->left;                                                                       \
+  }                                                                                    \
+  return x;                                                                            \
+}                                                                                      \
+                                                                                       \
+static inline name##_node *name##_max(const name *t) {                                 \
+  name##_node *x = t->root;                                                            \
+  if (x == &t->nil) {                                                                  \
+    return NULL;                                                                       \
+  }                                                                                    \
+  while (x->right != &t->nil) {                                                        \
+    x = x->right;                                                                      \
+  }                                                                                    \
+  return x;                                                                            \
+}                                                                                      \
+                                                                                       \
+static inline name##_node *name##_next(const name *t, name##_node *x) {                \
+  if (x->right != &t->nil) {                                                           \
+    x = x->right;                                                                      \
+    while (x->left != &t->nil) {                                                       \
+      x = x->left;                                                                     \
+    }                                                                                  \
+    return x;                                                                          \
+  }                                                                                    \
+  name##_node *y = x->parent;                                                          \
+  while (y != &t->nil && x == y->right) {                                              \
+    x = y;                                                                             \
+    y = y->parent;                                                                     \
+  }                                                                                    \
+  return (y == &t->nil) ? NULL : y;                                                    \
+}                                                                                      \
+                                                                                       \
+static inline name##_node *name##_prev(const name *t, name##_node *x) {                \
+  if (x->left != &t->nil) {                                                            \
+    x = x->left;                                                                       \
+    while (x->right != &t->nil) {                                                      \
+      x = x->right;                                                                    \
+    }                                                                                  \
+    return x;                                                                          \
+  }                                                                                    \
+  name##_node *y = x->parent;                                                          \
+  while (y != &t->nil && x == y->left) {                                               \
+    x = y;                                                                             \
+    y = y->parent;                                                                     \
+  }                                                                                    \
+  return (y == &t->nil) ? NULL : y;                                                    \
+}                                                                                      \
+                                                                                       \
+static inline void name##_transplant(name *t, name##_node *u, name##_node *v) {        \
+  if (u->parent == &t->nil) {                                                          \
+    t->root = v;                                                                       \
+  } else if (u == u->parent->left) {                                                   \
+    u->parent->left = v;                                                               \
+  } else {                                                                             \
+    u->parent->right = v;                                                              \
+  }                                                                                    \
+  v->parent = u->parent;                                                               \
+}                                                                                      \
+                                                                                       \
+static inline void name##_delete_fixup(name *t, name##_node *x) {                      \
+  while (x != t->root && x->color == RBTREE_BLACK) {                                   \
+    if (x == x->parent->left) {                                                        \
+      name##_node *w = x->parent->right;                                               \
+      if (w->color == RBTREE_RED) {                                                    \
+        w->color = RBTREE_BLACK;                                                       \
+        x->parent->color = RBTREE_RED;                                                 \
+        name##_left_rotate(t, x->parent);                                              \
+        w = x->parent->right;                                                          \
+      }                                                                                \
+      if (w->left->color == RBTREE_BLACK && w->right->color == RBTREE_BLACK) {         \
+        w->color = RBTREE_RED;                                                         \
+        x = x->parent;                                                                 \
+      } else {                                                                         \
+        if (w->right->color == RBTREE_BLACK) {                                         \
+          w->left->color = RBTREE_BLACK;                                               \
+          w->color = RBTREE_RED;                                                       \
+          name##_right_rotate(t, w);                                                   \
+          w = x->parent->right;                                                        \
+        }                                                                              \
+        w->color = x->parent->color;                                                   \
+        x->parent->color = RBTREE_BLACK;                                               \
+        w->right->color = RBTREE_BLACK;                                                \
+        name##_left_rotate(t, x->parent);                                              \
+        x = t->root;                                                                   \
+      }                                                                                \
+    } else {                                                                           \
+      name##_node *w = x->parent->left;                                                \
+      if (w->color == RBTREE_RED) {                                                    \
+        w->color = RBTREE_BLACK;                                                       \
+        x->parent->color = RBTREE_RED;                                                 \
+        name##_right_rotate(t, x->parent);                                             \
+        w = x->parent->left;                                                           \
+      }                                                                                \
+      if (w->right->color == RBTREE_BLACK && w->left->color == RBTREE_BLACK) {         \
+        w->color = RBTREE_RED;                                                         \
+        x = x->parent;                                                                 \
+      } else {                                                                         \
+        if (w->left->color == RBTREE_BLACK) {                                          \
+          w->right->color = RBTREE_BLACK;                                              \
+          w->color = RBTREE_RED;                                                       \
+          name##_left_rotate(t, w);                                                    \
+          w = x->parent->left;                                                         \
+        }                                                                              \
+        w->color = x->parent->color;                                                   \
+        x->parent->color = RBTREE_BLACK;                                               \
+        w->left->color = RBTREE_BLACK;                                                 \
+        name##_right_rotate(t, x->parent);                                             \
+        x = t->root;                                                                   \
+      }                                                                                \
+    }                                                                                  \
+  }                                                                                    \
+  x->color = RBTREE_BLACK;                                                             \
+}                                                                                      \
+                                                                                       \
+static inline int name##_erase(name *t, name##_node *p) {                              \
+  name##_node *y = p;                                                                  \
+  name##_node *x;                                                                      \
+  color_t y_original_color = y->color;                                                 \
+                                                                                       \
+  if (p->left == &t->nil) {                                                            \
+    x = p->right;                                                                      \
+    name##_transplant(t, p, p->right);                                                 \
+  } else if (p->right == &t->nil) {                                                    \
+    x = p->left;                                                                       \
+    name##_transplant(t, p, p->left);                                                  \
+  } else {                                                                             \
+    y = p->right;                                                                      \
+    while (y->left != &t->nil) {                                                       \
+      y = y->left;                                                                     \
+    }                                                                                  \
+    y_original_color = y->color;                                                       \
+    x = y->right;                                                                      \
+    if (y->parent == p) {                                                              \
+      x->parent = y;                                                                   \
+    } else {                                                                           \
+      name##_transplant(t, y, y->right);                                               \
+      y->right = p->right;                                                             \
+      y->right->parent = y;                                                            \
+    }                                                                                  \
+    name##_transplant(t, p, y);                                                        \
+    y->left = p->left;                                                                 \
+    y->left->parent = y;                                                               \
+    y->color = p->color;                                                               \
+  }                                                                                    \
+  if (y_original_color == RBTREE_BLACK) {                                              \
+    name##_delete_fixup(t, x);                                                         \
+  }                                                                                    \
+  free(p);                                                                             \
+  t->count--;                                                                          \
+  return 0;                                                                            \
+}                                                                                      \
+                                                                                       \
+static inline size_t name##_size(const name *t) {                                      \
+  return t->count;                                                                     \
+}                                                                                      \
+                                                                                       \
+/* copy up to n keys in order into arr, return how many were copied */                 \
+static inline size_t name##_to_array(const name *t, K *arr, const size_t n) {          \
+  size_t idx = 0;                                                                      \
+  for (name##_node *x = name##_min(t); x != NULL && idx < n; x = name##_next(t, x)) {  \
+    arr[idx++] = x->key;                                                               \
+  }                                                                                    \
+  return idx;                                                                          \
+}
+
+#endif  // _RBTREE_GENERIC_H_
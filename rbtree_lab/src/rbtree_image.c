@@ -0,0 +1,286 @@
+#include "rbtree_image.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define IMAGE_MAGIC "RBTIMG\0\1"
+#define IMAGE_VERSION 1
+
+// 레코드들을 8바이트 단위로 섞는 checksum (FNV-1a를 바이트 대신 word 단위로 적용)
+static uint64_t image_checksum(const rbtree_image_node *nodes, const size_t count) {
+  const uint64_t *words = (const uint64_t *)nodes;
+  const size_t nwords = count * sizeof(rbtree_image_node) / sizeof(uint64_t);
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < nwords; i++) {
+    h = (h ^ words[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+#if !defined(RBTREE_COUNTED) && !defined(RBTREE_INTERVAL)
+// x를 root로 하는 서브트리를 중위 순서대로 out에 기록하고 x가 놓인 레코드 번호를 반환
+// 레코드 번호가 key 순서와 같으므로 순회는 배열을 앞에서부터 읽기만 하면 됨
+static uint32_t emit_subtree(const rbtree *t, const node_t *x, rbtree_image_node *out, uint32_t *next) {
+  if (x == t->nil) {
+    return RBTREE_IMAGE_NIL;
+  }
+  const uint32_t left = emit_subtree(t, x->left, out, next);
+  const uint32_t i = (*next)++;
+  const uint32_t right = emit_subtree(t, x->right, out, next);
+
+  out[i].key = x->key;
+  out[i].left = left;
+  out[i].right = right;
+  out[i].color = x->color;
+  return i;
+}
+#endif
+
+#ifdef RBTREE_COUNTED
+// 노드마다 모여 있는 같은 key들을 펼쳐서 중위 순서대로 out의 key에 기록
+static void emit_keys(const rbtree *t, const node_t *x, rbtree_image_node *out, uint32_t *next) {
+  while (x != t->nil) {
+    emit_keys(t, x->left, out, next);
+    for (size_t c = x->copies; c > 0; c--) {
+      out[(*next)++].key = x->key;
+    }
+    x = x->right;
+  }
+}
+
+// 레코드 [lo, hi)를 완전 균형 트리로 연결하고 루트의 레코드 번호를 반환 (rbtree_from_sorted와 같은 모양)
+static uint32_t link_balanced(rbtree_image_node *out, const uint32_t lo, const uint32_t hi, const int depth,
+                              const int red_depth) {
+  if (lo >= hi) {
+    return RBTREE_IMAGE_NIL;
+  }
+  const uint32_t mid = lo + (hi - lo) / 2;
+  out[mid].left = link_balanced(out, lo, mid, depth + 1, red_depth);
+  out[mid].right = link_balanced(out, mid + 1, hi, depth + 1, red_depth);
+  out[mid].color = (depth == red_depth) ? RBTREE_RED : RBTREE_BLACK;
+  return mid;
+}
+#endif
+
+#ifndef RBTREE_INTERVAL
+// 열린 빈 파일 fd를 size 크기로 만든 뒤 mmap으로 직접 채우는 함수, 성공하면 0 실패하면 -1
+// 트리 크기만큼의 버퍼가 따로 필요 없고, magic은 나머지가 디스크에 닿은 뒤에 기록한다.
+static int write_image(const rbtree *t, const int fd, const size_t size) {
+  const size_t count = t->count;
+  if (ftruncate(fd, (off_t)size) != 0) {
+    return -1;
+  }
+  void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+
+  rbtree_image_header *header = (rbtree_image_header *)map;
+  rbtree_image_node *nodes = (rbtree_image_node *)(header + 1);
+  uint32_t next = 0;
+#ifdef RBTREE_COUNTED
+  // 레코드 하나가 key 하나이므로 key를 펼친 뒤 모양은 새로 만듦 (덜 찬 마지막 레벨만 RED)
+  emit_keys(t, t->root, nodes, &next);
+  int levels = 0;
+  while (((size_t)1 << levels) - 1 < count) {
+    levels++;
+  }
+  const int red_depth = (((size_t)1 << levels) - 1 == count) ? -1 : levels - 1;
+  header->root = link_balanced(nodes, 0, (uint32_t)count, 0, red_depth);
+#else
+  header->root = emit_subtree(t, t->root, nodes, &next);
+#endif
+  header->version = IMAGE_VERSION;
+  header->node_size = sizeof(rbtree_image_node);
+  header->key_size = sizeof(key_t);
+  header->count = count;
+  header->checksum = image_checksum(nodes, count);
+
+  int ret = msync(map, size, MS_SYNC);
+  memcpy(header->magic, IMAGE_MAGIC, sizeof(header->magic));
+  if (ret == 0) {
+    ret = msync(map, sizeof(rbtree_image_header), MS_SYNC);
+  }
+  munmap(map, size);
+  return ret == 0 ? 0 : -1;
+}
+#endif
+
+// 트리를 path에 이미지로 저장, 성공하면 0 실패하면 -1
+// 같은 디렉터리의 임시 파일(path.XXXXXX)에 다 쓰고 fsync한 뒤 rename으로 바꿔 넣으므로,
+// 저장이 중간에 실패해도 기존 파일은 그대로 남고, 기존 파일을 열어둔 쪽은 계속 이전 이미지를 읽는다.
+// 레코드에 구간의 끝(hi)을 담을 자리가 없으므로 RBTREE_INTERVAL에서는 파일을 건드리지 않고 -1 반환
+int rbtree_save(const rbtree *t, const char *path) {
+#ifdef RBTREE_INTERVAL
+  (void)t;
+  (void)path;
+  return -1;
+#else
+  if (t->count >= RBTREE_IMAGE_NIL) {
+    return -1;
+  }
+  const size_t size = sizeof(rbtree_image_header) + t->count * sizeof(rbtree_image_node);
+
+  const size_t len = strlen(path);
+  char *tmp = (char *)malloc(len + sizeof(".XXXXXX"));
+  memcpy(tmp, path, len);
+  memcpy(tmp + len, ".XXXXXX", sizeof(".XXXXXX"));
+  const int fd = mkstemp(tmp);
+  if (fd < 0) {
+    free(tmp);
+    return -1;
+  }
+
+  int ret = fchmod(fd, 0644);  // mkstemp는 0600으로 만듦
+  if (ret == 0) {
+    ret = write_image(t, fd, size);
+  }
+  if (ret == 0) {
+    ret = fsync(fd);
+  }
+  close(fd);
+  if (ret == 0) {
+    ret = rename(tmp, path);
+  }
+  if (ret != 0) {
+    unlink(tmp);
+  }
+  free(tmp);
+  return ret == 0 ? 0 : -1;
+#endif
+}
+
+// 이미지를 읽기 전용으로 map, header가 맞지 않으면 NULL
+// 레코드는 읽지 않으므로 열기는 파일 크기와 상관없이 바로 끝나고, 각 페이지는 처음 접근할 때 읽힘
+rbtree_image *rbtree_open_mmap(const char *path) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(rbtree_image_header)) {
+    close(fd);
+    return NULL;
+  }
+  const size_t size = (size_t)st.st_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  const rbtree_image_header *header = (const rbtree_image_header *)map;
+  if (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) != 0 || header->version != IMAGE_VERSION ||
+      header->node_size != sizeof(rbtree_image_node) || header->key_size != sizeof(key_t) ||
+      header->count >= RBTREE_IMAGE_NIL ||
+      size != sizeof(rbtree_image_header) + header->count * sizeof(rbtree_image_node) ||
+      (header->count == 0) != (header->root == RBTREE_IMAGE_NIL) ||
+      (header->count > 0 && header->root >= header->count)) {
+    munmap(map, size);
+    return NULL;
+  }
+
+  rbtree_image *img = (rbtree_image *)malloc(sizeof(rbtree_image));
+  img->header = header;
+  img->nodes = (const rbtree_image_node *)(header + 1);
+  img->map_size = size;
+  return img;
+}
+
+void rbtree_close_mmap(rbtree_image *img) {
+  munmap((void *)img->header, img->map_size);
+  free(img);
+}
+
+// i를 root로 하는 서브트리가 [lo, hi) 번호를 빠짐없이 정확히 채우는지 확인
+// 중위 번호이므로 왼쪽 서브트리는 [lo, i), 오른쪽 서브트리는 [i + 1, hi)여야 하고, 그러면 순환도 생길 수 없음
+static int check_subtree(const rbtree_image *img, const uint32_t i, const uint32_t lo, const uint32_t hi,
+                         const int depth) {
+  if (i == RBTREE_IMAGE_NIL) {
+    return lo == hi;
+  }
+  if (depth > 64 || i < lo || i >= hi) {  // 32비트 번호의 RB tree 높이는 64를 넘을 수 없음
+    return 0;
+  }
+  const rbtree_image_node *p = &img->nodes[i];
+  return check_subtree(img, p->left, lo, i, depth + 1) && check_subtree(img, p->right, i + 1, hi, depth + 1);
+}
+
+// checksum, 트리 모양, key 순서를 모두 확인, 정상이면 0 아니면 -1
+int rbtree_image_verify(const rbtree_image *img) {
+  const uint32_t count = (uint32_t)img->header->count;
+  if (image_checksum(img->nodes, count) != img->header->checksum ||
+      !check_subtree(img, img->header->root, 0, count, 0)) {
+    return -1;
+  }
+  for (uint32_t i = 1; i < count; i++) {
+    if (img->nodes[i - 1].key > img->nodes[i].key) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+size_t rbtree_image_size(const rbtree_image *img) {
+  return img->header->count;
+}
+
+// key와 같은 레코드를 반환, 없으면 NULL (rbtree_find와 같은 순서로 내려감)
+const rbtree_image_node *rbtree_image_find(const rbtree_image *img, const key_t key) {
+  uint32_t i = img->header->root;
+  while (i != RBTREE_IMAGE_NIL) {
+    const rbtree_image_node *p = &img->nodes[i];
+    if (p->key == key) {
+      return p;
+    }
+    i = (p->key > key) ? p->left : p->right;
+  }
+  return NULL;
+}
+
+// key 이상인 첫 레코드, 없으면 NULL
+const rbtree_image_node *rbtree_image_lower_bound(const rbtree_image *img, const key_t key) {
+  const rbtree_image_node *res = NULL;
+  uint32_t i = img->header->root;
+  while (i != RBTREE_IMAGE_NIL) {
+    const rbtree_image_node *p = &img->nodes[i];
+    if (p->key >= key) {
+      res = p;
+      i = p->left;
+    } else {
+      i = p->right;
+    }
+  }
+  return res;
+}
+
+// 레코드가 key 순서로 놓여 있으므로 min/max/next/prev는 배열 위치로 바로 구함
+const rbtree_image_node *rbtree_image_min(const rbtree_image *img) {
+  return img->header->count > 0 ? &img->nodes[0] : NULL;
+}
+
+const rbtree_image_node *rbtree_image_max(const rbtree_image *img) {
+  return img->header->count > 0 ? &img->nodes[img->header->count - 1] : NULL;
+}
+
+const rbtree_image_node *rbtree_image_next(const rbtree_image *img, const rbtree_image_node *p) {
+  return (p != NULL && p + 1 < img->nodes + img->header->count) ? p + 1 : NULL;
+}
+
+const rbtree_image_node *rbtree_image_prev(const rbtree_image *img, const rbtree_image_node *p) {
+  return (p != NULL && p > img->nodes) ? p - 1 : NULL;
+}
+
+// key 순서대로 arr에 최대 n개 저장하고 저장한 개수를 반환
+size_t rbtree_image_to_array(const rbtree_image *img, key_t *arr, const size_t n) {
+  const size_t count = (img->header->count < n) ? img->header->count : n;
+  for (size_t i = 0; i < count; i++) {
+    arr[i] = img->nodes[i].key;
+  }
+  return count;
+}
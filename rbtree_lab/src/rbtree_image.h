@@ -0,0 +1,59 @@
+#ifndef _RBTREE_IMAGE_H_
+#define _RBTREE_IMAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// On-disk tree image. Nodes are stored in key order and refer to their
+// children by record index instead of by pointer, so the file can be mapped
+// at any address and searched in place; only the pages a lookup touches are
+// ever read from disk. The layout is native-endian.
+#define RBTREE_IMAGE_NIL UINT32_MAX
+
+typedef struct {
+  key_t key;
+  uint32_t left, right;  // record index of each child, RBTREE_IMAGE_NIL if none
+  uint32_t color;        // color_t of the node when it was saved
+} rbtree_image_node;     // 16 bytes
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t node_size;  // sizeof(rbtree_image_node) of the writer
+  uint64_t count;
+  uint32_t root;  // record index of the root, RBTREE_IMAGE_NIL if empty
+  uint32_t key_size;  // sizeof(key_t) of the writer
+  uint64_t checksum;  // over the node records, see rbtree_image_verify
+  uint8_t reserved[24];
+} rbtree_image_header;  // 64 bytes, node records follow
+
+typedef struct {
+  const rbtree_image_header *header;
+  const rbtree_image_node *nodes;  // header->count records in key order
+  size_t map_size;
+} rbtree_image;
+
+// returns 0 on success, -1 on failure; always -1 under RBTREE_INTERVAL since
+// the records have no room for the interval ends. The image is written to a
+// temporary file next to path and renamed over it, so a failed save leaves the
+// old file alone and images already open keep reading the old contents
+int rbtree_save(const rbtree *, const char *path);
+rbtree_image *rbtree_open_mmap(const char *path);
+void rbtree_close_mmap(rbtree_image *);
+
+// open only checks the header; this reads every record and checks the sum,
+// the tree shape and the key order (use it before trusting a foreign file)
+int rbtree_image_verify(const rbtree_image *);
+
+size_t rbtree_image_size(const rbtree_image *);
+const rbtree_image_node *rbtree_image_find(const rbtree_image *, const key_t);
+const rbtree_image_node *rbtree_image_lower_bound(const rbtree_image *, const key_t);
+const rbtree_image_node *rbtree_image_min(const rbtree_image *);
+const rbtree_image_node *rbtree_image_max(const rbtree_image *);
+const rbtree_image_node *rbtree_image_next(const rbtree_image *, const rbtree_image_node *);
+const rbtree_image_node *rbtree_image_prev(const rbtree_image *, const rbtree_image_node *);
+size_t rbtree_image_to_array(const rbtree_image *, key_t *, const size_t);
+
+#endif  // _RBTREE_IMAGE_H_
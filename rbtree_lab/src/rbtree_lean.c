@@ -0,0 +1,312 @@
+#include "rbtree_lean.h"
+
+#include <stdlib.h>
+
+// 노드는 parent pointer 없이 link[0](왼쪽), link[1](오른쪽)만 가진다.
+// 삽입과 삭제는 root에서 한 번만 내려가며, 내려가는 동안 색 변경과 회전을 미리 해 두어
+// 맨 아래에서 노드를 붙이거나 떼어낸 뒤 다시 올라갈 필요가 없게 한다. (top-down red-black tree)
+// 회전은 서브트리 root를 반환하고, 호출한 쪽이 그것을 부모의 link에 저장한다.
+
+struct lrb_chunk {
+  struct lrb_chunk *next;     // 이전에 할당한 chunk
+  lrb_node nodes[LRB_CHUNK];
+};
+
+static inline int is_red(const lrb_node *x) {
+  return x != NULL && x->color == RBTREE_RED;
+}
+
+// 노드 하나를 할당 : 지운 노드가 있으면 재사용, 없으면 chunk에서 잘라냄
+static lrb_node *node_new(lrbtree *t, const key_t key) {
+  lrb_node *x;
+  if (t->free_list != NULL) {
+    x = t->free_list;
+    t->free_list = x->link[1];
+  } else {
+    if (t->chunks == NULL || t->used == LRB_CHUNK) {
+      lrb_chunk *c = (lrb_chunk *)malloc(sizeof(lrb_chunk));
+      c->next = t->chunks;
+      t->chunks = c;
+      t->used = 0;
+    }
+    x = &t->chunks->nodes[t->used++];
+  }
+  x->key = key;
+  x->color = RBTREE_RED;
+  x->link[0] = x->link[1] = NULL;
+  return x;
+}
+
+static void node_free(lrbtree *t, lrb_node *x) {
+  x->link[1] = t->free_list;
+  t->free_list = x;
+}
+
+lrbtree *new_lrbtree(void) {
+  return (lrbtree *)calloc(1, sizeof(lrbtree));
+}
+
+void delete_lrbtree(lrbtree *t) {
+  // 노드를 하나씩 찾아다니지 않고 chunk 단위로 해제
+  lrb_chunk *c = t->chunks;
+  while (c != NULL) {
+    lrb_chunk *next = c->next;
+    free(c);
+    c = next;
+  }
+  free(t);
+}
+
+// x를 dir 방향으로 회전 : x의 반대쪽 자식 y가 올라오며 BLACK, 내려가는 x는 RED가 됨
+// 두 link만 고치면 되고 parent pointer를 따라 고칠 것이 없음
+static lrb_node *rotate(lrb_node *x, const int dir) {
+  lrb_node *y = x->link[!dir];
+  x->link[!dir] = y->link[dir];
+  y->link[dir] = x;
+  x->color = RBTREE_RED;
+  y->color = RBTREE_BLACK;
+  return y;
+}
+
+// 꺾인 모양 : 자식을 먼저 반대로 돌려 직선 모양으로 만든 뒤 x를 회전
+static lrb_node *rotate_double(lrb_node *x, const int dir) {
+  x->link[!dir] = rotate(x->link[!dir], !dir);
+  return rotate(x, dir);
+}
+
+void lrbtree_insert(lrbtree *t, const key_t key) {
+  lrb_node *z = node_new(t, key);
+  t->count++;
+  if (t->root == NULL) {
+    z->color = RBTREE_BLACK;
+    t->root = z;
+    return;
+  }
+
+  // head는 root 위의 가짜 노드 (head.link[1]이 root) : root가 회전으로 바뀌어도 같은 방식으로 고칠 수 있음
+  lrb_node head = {.color = RBTREE_BLACK, .link = {NULL, t->root}};
+  lrb_node *gg = &head;  // 증조부모
+  lrb_node *g = NULL, *p = NULL, *q = t->root;
+  int dir = 0, last = 0;
+
+  for (;;) {
+    if (q == NULL) {
+      // 맨 아래에 새 노드(RED)를 붙임
+      p->link[dir] = q = z;
+    } else if (is_red(q->link[0]) && is_red(q->link[1])) {
+      // 자식이 둘 다 RED면 색을 뒤집어 RED를 위로 올림 : 아래에 붙일 자리의 형제가 RED일 일이 없어짐
+      q->color = RBTREE_RED;
+      q->link[0]->color = RBTREE_BLACK;
+      q->link[1]->color = RBTREE_BLACK;
+    }
+
+    // 위에서 RED가 연달아 나오면 조부모에서 회전해 바로 고침 (증조부모 link를 고침)
+    if (is_red(q) && is_red(p)) {
+      const int dir2 = gg->link[1] == g;
+      gg->link[dir2] = (q == p->link[last]) ? rotate(g, !last) : rotate_double(g, !last);
+    }
+
+    if (q == z) {
+      break;
+    }
+    last = dir;
+    dir = key >= q->key;  // 같은 key는 오른쪽으로
+    if (g != NULL) {
+      gg = g;
+    }
+    g = p;
+    p = q;
+    q = q->link[dir];
+  }
+
+  t->root = head.link[1];
+  t->root->color = RBTREE_BLACK;
+}
+
+const lrb_node *lrbtree_find(const lrbtree *t, const key_t key) {
+  const lrb_node *x = t->root;
+  while (x != NULL) {
+    if (x->key == key) {
+      return x;
+    }
+    x = x->link[key > x->key];
+  }
+  return NULL;
+}
+
+// key 하나를 지우고 1 반환, 없으면 0
+// 내려가는 동안 지금 노드 q가 항상 RED이거나 RED 자식을 갖도록 RED를 아래로 밀어 두므로,
+// 맨 아래의 노드를 떼어내도 black height가 변하지 않는다.
+int lrbtree_erase(lrbtree *t, const key_t key) {
+  // 없는 key 때문에 내려가며 색과 모양을 바꾸지 않도록 먼저 읽기만 해서 확인 (경로는 cache에 남음)
+  if (lrbtree_find(t, key) == NULL) {
+    return 0;
+  }
+
+  lrb_node head = {.color = RBTREE_BLACK, .link = {NULL, t->root}};
+  lrb_node *g = NULL, *p = NULL, *q = &head;
+  lrb_node *f = NULL;  // 지금까지 만난 key와 같은 노드 중 가장 아래의 것
+  int dir = 1;
+
+  while (q->link[dir] != NULL) {
+    const int last = dir;
+    g = p;
+    p = q;
+    q = q->link[dir];
+    dir = q->key < key;  // 같은 key는 왼쪽으로 : 끝까지 내려가면 f의 바로 앞 노드에 닿음
+    if (q->key == key) {
+      f = q;
+    }
+
+    if (!is_red(q) && !is_red(q->link[dir])) {
+      if (is_red(q->link[!dir])) {
+        // 반대쪽 RED 자식을 올려 q 위에 두고 q를 RED로 만듦
+        p = p->link[last] = rotate(q, dir);
+      } else {
+        lrb_node *s = p->link[!last];  // 형제
+        if (s != NULL) {
+          if (!is_red(s->link[!last]) && !is_red(s->link[last])) {
+            // 형제 쪽에도 RED가 없으면 색만 뒤집어 p의 RED를 q와 형제에게 내림
+            p->color = RBTREE_BLACK;
+            s->color = RBTREE_RED;
+            q->color = RBTREE_RED;
+          } else {
+            // 형제 쪽의 RED를 회전으로 가져와 q를 RED로 만듦
+            const int dir2 = g->link[1] == p;
+            if (is_red(s->link[last])) {
+              g->link[dir2] = rotate_double(p, last);
+            } else {
+              g->link[dir2] = rotate(p, last);
+            }
+            lrb_node *top = g->link[dir2];
+            q->color = top->color = RBTREE_RED;
+            top->link[0]->color = RBTREE_BLACK;
+            top->link[1]->color = RBTREE_BLACK;
+          }
+        }
+      }
+    }
+  }
+
+  // 맨 아래의 q(자식이 하나 이하)를 떼어내고, 그 key를 f로 옮김
+  if (f != NULL) {
+    f->key = q->key;
+    p->link[p->link[1] == q] = q->link[q->link[0] == NULL];
+    node_free(t, q);
+    t->count--;
+  }
+
+  t->root = head.link[1];
+  if (t->root != NULL) {
+    t->root->color = RBTREE_BLACK;
+  }
+  return f != NULL;
+}
+
+// 가장 바깥쪽(dir 방향 끝) 노드, 빈 트리면 NULL
+static const lrb_node *extreme(const lrbtree *t, const int dir) {
+  const lrb_node *x = t->root;
+  while (x != NULL && x->link[dir] != NULL) {
+    x = x->link[dir];
+  }
+  return x;
+}
+
+const lrb_node *lrbtree_min(const lrbtree *t) {
+  return extreme(t, 0);
+}
+
+const lrb_node *lrbtree_max(const lrbtree *t) {
+  return extreme(t, 1);
+}
+
+size_t lrbtree_size(const lrbtree *t) {
+  return t->count;
+}
+
+// key 순서대로 arr에 최대 n개 저장하고 저장한 개수를 반환
+// 다시 올라갈 일이 남은 조상(왼쪽으로 내려간 조상)만 쌓으면 되므로 cursor보다 가볍게 돈다.
+size_t lrbtree_to_array(const lrbtree *t, key_t *arr, const size_t n) {
+  const lrb_node *stack[LRB_MAX_HEIGHT];
+  int top = 0;
+  size_t idx = 0;
+  const lrb_node *x = t->root;
+  while (idx < n) {
+    while (x != NULL) {
+      stack[top++] = x;
+      x = x->link[0];
+    }
+    if (top == 0) {
+      break;
+    }
+    x = stack[--top];
+    arr[idx++] = x->key;
+    x = x->link[1];
+  }
+  return idx;
+}
+
+// x부터 dir 방향 끝까지 내려가며 경로를 쌓음
+static void push_spine(lrb_cursor *c, const lrb_node *x, const int dir) {
+  while (x != NULL) {
+    c->stack[c->depth++] = x;
+    x = x->link[dir];
+  }
+}
+
+void lrb_cursor_first(lrb_cursor *c, const lrbtree *t) {
+  c->depth = 0;
+  push_spine(c, t->root, 0);
+}
+
+void lrb_cursor_last(lrb_cursor *c, const lrbtree *t) {
+  c->depth = 0;
+  push_spine(c, t->root, 1);
+}
+
+// key 이상인 첫 노드에 위치 : 끝까지 내려간 경로에서 그 노드까지만 남김
+void lrb_cursor_seek(lrb_cursor *c, const lrbtree *t, const key_t key) {
+  int found = 0;
+  c->depth = 0;
+  const lrb_node *x = t->root;
+  while (x != NULL) {
+    c->stack[c->depth++] = x;
+    if (x->key >= key) {
+      found = c->depth;
+      x = x->link[0];
+    } else {
+      x = x->link[1];
+    }
+  }
+  c->depth = found;
+}
+
+int lrb_cursor_valid(const lrb_cursor *c) {
+  return c->depth > 0;
+}
+
+const lrb_node *lrb_cursor_node(const lrb_cursor *c) {
+  return c->stack[c->depth - 1];
+}
+
+// dir(1이면 다음, 0이면 이전) 방향으로 한 칸 이동
+// dir 쪽 서브트리가 있으면 그 안의 반대쪽 끝으로, 없으면 dir 쪽에서 올라오지 않은 첫 조상으로
+static void cursor_step(lrb_cursor *c, const int dir) {
+  const lrb_node *x = c->stack[c->depth - 1];
+  if (x->link[dir] != NULL) {
+    push_spine(c, x->link[dir], !dir);
+    return;
+  }
+  c->depth--;
+  while (c->depth > 0 && c->stack[c->depth - 1]->link[dir] == x) {
+    x = c->stack[--c->depth];
+  }
+}
+
+void lrb_cursor_next(lrb_cursor *c) {
+  cursor_step(c, 1);
+}
+
+void lrb_cursor_prev(lrb_cursor *c) {
+  cursor_step(c, 0);
+}
@@ -0,0 +1,61 @@
+#ifndef _RBTREE_LEAN_H_
+#define _RBTREE_LEAN_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// Red-black multiset without parent pointers. Insert and erase rebalance on
+// the way down in a single top-down pass (color flips and rotations ahead of
+// the node being added or removed), so no path is remembered and a rotation
+// rewrites two child links instead of up to six links. Nodes are 24 bytes,
+// carved from chunks of LRB_CHUNK, against 40 (32 with
+// -DRBTREE_NO_ORDER_STATS) for node_t. Iteration goes through a cursor that
+// keeps the root-to-node path on an explicit stack.
+#define LRB_CHUNK 1024
+// tree height is at most 2 * log2(n + 1)
+#define LRB_MAX_HEIGHT 128
+
+typedef struct lrb_node {
+  key_t key;
+  color_t color;
+  struct lrb_node *link[2];  // left, right; NULL for no child
+} lrb_node;
+
+typedef struct lrb_chunk lrb_chunk;
+
+typedef struct {
+  lrb_node *root;
+  size_t count;
+  lrb_chunk *chunks;
+  size_t used;           // nodes handed out from the newest chunk
+  lrb_node *free_list;   // erased nodes, linked through link[1]
+} lrbtree;
+
+// path from the root to the current node; erase may move keys between
+// nodes, so a cursor (and any node pointer) is only good until the next update
+typedef struct {
+  const lrb_node *stack[LRB_MAX_HEIGHT];
+  int depth;  // 0 once the scan runs off either end
+} lrb_cursor;
+
+lrbtree *new_lrbtree(void);
+void delete_lrbtree(lrbtree *);
+
+void lrbtree_insert(lrbtree *, const key_t);
+int lrbtree_erase(lrbtree *, const key_t);  // removes one copy, 1 if found
+const lrb_node *lrbtree_find(const lrbtree *, const key_t);
+const lrb_node *lrbtree_min(const lrbtree *);
+const lrb_node *lrbtree_max(const lrbtree *);
+size_t lrbtree_size(const lrbtree *);
+size_t lrbtree_to_array(const lrbtree *, key_t *, const size_t);
+
+void lrb_cursor_first(lrb_cursor *, const lrbtree *);
+void lrb_cursor_last(lrb_cursor *, const lrbtree *);
+void lrb_cursor_seek(lrb_cursor *, const lrbtree *, const key_t);  // first key >= given key
+int lrb_cursor_valid(const lrb_cursor *);
+const lrb_node *lrb_cursor_node(const lrb_cursor *);
+void lrb_cursor_next(lrb_cursor *);
+void lrb_cursor_prev(lrb_cursor *);
+
+#endif  // _RBTREE_LEAN_H_
@@ -0,0 +1,390 @@
+#include "rbtree_persist.h"
+
+#include <stdlib.h>
+
+// 노드는 parent pointer 대신 참조 수를 가지므로 여러 버전(snapshot)이 같은 서브트리를 공유할 수 있다.
+// 쓰기 규칙 : writer는 root에서부터 내려가며 경로의 노드를 own()으로 단독 소유로 만든 뒤에만 고친다.
+// 부모가 단독 소유이면서 참조 수가 1인 노드는 다른 어떤 버전에서도 닿을 수 없으므로 제자리에서 고쳐도 안전하다.
+
+static inline int is_red(const prb_node *n) {
+  return n != NULL && n->color == RBTREE_RED;
+}
+
+static void node_retain(prb_node *n) {
+  if (n != NULL) {
+    __atomic_add_fetch(&n->refs, 1, __ATOMIC_RELAXED);
+  }
+}
+
+// 참조를 하나 내려놓고, 마지막 참조였다면 노드를 해제하며 자식들의 참조도 내려놓음
+// reader 스레드에서 호출될 수 있으므로 참조 수는 atomic으로 다룸
+static void node_release(prb_node *n) {
+  while (n != NULL && __atomic_sub_fetch(&n->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    node_release(n->left);
+    prb_node *right = n->right;  // 오른쪽은 반복으로 처리해 재귀 깊이를 줄임
+    free(n);
+    n = right;
+  }
+}
+
+// 고치기 전에 노드를 단독 소유로 만드는 함수 : 다른 버전과 공유 중이면 복사본을 반환
+// 호출한 쪽은 부모(또는 root)가 반환값을 가리키도록 고쳐야 함
+static prb_node *own(prb_node *n) {
+  if (__atomic_load_n(&n->refs, __ATOMIC_ACQUIRE) == 1) {
+    return n;
+  }
+  prb_node *c = (prb_node *)malloc(sizeof(prb_node));
+  c->color = n->color;
+  c->key = n->key;
+  c->refs = 1;
+  c->left = n->left;
+  c->right = n->right;
+  node_retain(c->left);  // 자식은 복사하지 않고 공유
+  node_retain(c->right);
+  node_release(n);  // 부모가 n 대신 c를 가리키게 되므로
+  return c;
+}
+
+static prb_node *own_left(prb_node *p) {
+  return p->left = own(p->left);
+}
+
+static prb_node *own_right(prb_node *p) {
+  return p->right = own(p->right);
+}
+
+// path[i]를 가리키는 칸 (root 또는 부모의 left/right)
+static prb_node **link_to(prbtree *t, prb_node **path, const int i) {
+  if (i == 0) {
+    return &t->head.root;
+  }
+  return (path[i - 1]->left == path[i]) ? &path[i - 1]->left : &path[i - 1]->right;
+}
+
+// 회전은 x와 올라오는 자식만 고치고 서브트리는 그대로 옮김 (둘 다 단독 소유여야 함)
+// 새 서브트리의 root를 반환하므로 호출한 쪽이 x를 가리키던 칸에 저장해야 함
+static prb_node *rotate_left(prb_node *x) {
+  prb_node *y = x->right;
+  x->right = y->left;
+  y->left = x;
+  return y;
+}
+
+static prb_node *rotate_right(prb_node *x) {
+  prb_node *y = x->left;
+  x->left = y->right;
+  y->right = x;
+  return y;
+}
+
+// rbtree.c의 rbtree_insert_fixup과 같은 경우 분류, 부모는 parent pointer 대신 path에서 찾음
+// path[0..i]는 root부터 새 노드까지의 경로이고 모두 단독 소유
+static void prb_insert_fixup(prbtree *t, prb_node **path, int i) {
+  while (i >= 2 && is_red(path[i - 1])) {
+    prb_node *p = path[i - 1];
+    prb_node *g = path[i - 2];
+    prb_node **link = link_to(t, path, i - 2);
+
+    if (p == g->left) {
+      if (is_red(g->right)) {  // 삼촌이 RED : 색 변경 후 조부모로 이동
+        own_right(g)->color = RBTREE_BLACK;
+        p->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        i -= 2;
+        continue;
+      }
+      if (path[i] == p->right) {  // 꺾인 모양 : 직선 모양으로 변환
+        p = g->left = rotate_left(p);
+      }
+      p->color = RBTREE_BLACK;
+      g->color = RBTREE_RED;
+      *link = rotate_right(g);
+    } else {  // 대칭
+      if (is_red(g->left)) {
+        own_left(g)->color = RBTREE_BLACK;
+        p->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        i -= 2;
+        continue;
+      }
+      if (path[i] == p->left) {
+        p = g->right = rotate_right(p);
+      }
+      p->color = RBTREE_BLACK;
+      g->color = RBTREE_RED;
+      *link = rotate_left(g);
+    }
+    break;
+  }
+  t->head.root->color = RBTREE_BLACK;
+}
+
+// rbtree.c의 rbtree_delete_fixup과 같은 경우 분류
+// path[i]는 빠진 노드를 대신한 x (nil이면 NULL), path[0..i-1]은 모두 단독 소유
+// 형제와 조카는 색을 바꾸거나 회전하기 직전에 단독 소유로 만듦
+static void prb_delete_fixup(prbtree *t, prb_node **path, int i) {
+  prb_node *x = path[i];
+
+  while (i > 0 && !is_red(x)) {
+    prb_node *xp = path[i - 1];
+
+    if (x == xp->left) {
+      prb_node *w = own_right(xp);  // 형제 노드
+
+      if (is_red(w)) {  // Case 1
+        w->color = RBTREE_BLACK;
+        xp->color = RBTREE_RED;
+        *link_to(t, path, i - 1) = rotate_left(xp);
+        path[i - 1] = w;  // w가 xp 위로 올라가 x의 경로가 한 칸 길어짐
+        path[i] = xp;
+        i++;
+        w = own_right(xp);
+      }
+      if (!is_red(w->left) && !is_red(w->right)) {  // Case 2
+        w->color = RBTREE_RED;
+        x = xp;
+        i--;
+      } else {
+        if (!is_red(w->right)) {  // Case 3
+          own_left(w)->color = RBTREE_BLACK;
+          w->color = RBTREE_RED;
+          w = xp->right = rotate_right(w);
+        }
+        w->color = xp->color;  // Case 4
+        xp->color = RBTREE_BLACK;
+        own_right(w)->color = RBTREE_BLACK;
+        *link_to(t, path, i - 1) = rotate_left(xp);
+        x = t->head.root;
+        break;
+      }
+    } else {  // 대칭
+      prb_node *w = own_left(xp);
+
+      if (is_red(w)) {
+        w->color = RBTREE_BLACK;
+        xp->color = RBTREE_RED;
+        *link_to(t, path, i - 1) = rotate_right(xp);
+        path[i - 1] = w;
+        path[i] = xp;
+        i++;
+        w = own_left(xp);
+      }
+      if (!is_red(w->right) && !is_red(w->left)) {
+        w->color = RBTREE_RED;
+        x = xp;
+        i--;
+      } else {
+        if (!is_red(w->left)) {
+          own_right(w)->color = RBTREE_BLACK;
+          w->color = RBTREE_RED;
+          w = xp->left = rotate_left(w);
+        }
+        w->color = xp->color;
+        xp->color = RBTREE_BLACK;
+        own_left(w)->color = RBTREE_BLACK;
+        *link_to(t, path, i - 1) = rotate_right(xp);
+        x = t->head.root;
+        break;
+      }
+    }
+  }
+  if (x != NULL) {
+    x->color = RBTREE_BLACK;
+  }
+}
+
+prbtree *new_prbtree(void) {
+  prbtree *t = (prbtree *)calloc(1, sizeof(prbtree));
+  pthread_mutex_init(&t->lock, NULL);
+  return t;
+}
+
+// 아직 놓지 않은 snapshot이 있으면 공유 중인 노드들은 그 snapshot이 놓일 때 해제됨
+void delete_prbtree(prbtree *t) {
+  node_release(t->head.root);
+  pthread_mutex_destroy(&t->lock);
+  free(t);
+}
+
+void prbtree_insert(prbtree *t, const key_t key) {
+  prb_node *path[PRB_MAX_HEIGHT];
+  int d = 0;
+
+  pthread_mutex_lock(&t->lock);
+  prb_node **link = &t->head.root;
+  while (*link != NULL) {  // 내려가면서 경로를 단독 소유로 만듦 (같은 key는 오른쪽으로)
+    prb_node *x = *link = own(*link);
+    path[d++] = x;
+    link = (key < x->key) ? &x->left : &x->right;
+  }
+
+  prb_node *z = (prb_node *)calloc(1, sizeof(prb_node));
+  z->color = RBTREE_RED;  // 새 노드는 RED
+  z->key = key;
+  z->refs = 1;
+  *link = z;
+  path[d] = z;
+
+  prb_insert_fixup(t, path, d);
+  t->head.count++;
+  pthread_mutex_unlock(&t->lock);
+}
+
+// key 하나를 지우고 1 반환, 없으면 0
+int prbtree_erase(prbtree *t, const key_t key) {
+  prb_node *path[PRB_MAX_HEIGHT];
+  int d = 0;
+
+  pthread_mutex_lock(&t->lock);
+  // 없는 key 때문에 경로를 복사하지 않도록 먼저 읽기만 해서 확인
+  if (prb_find(&t->head, key) == NULL) {
+    pthread_mutex_unlock(&t->lock);
+    return 0;
+  }
+
+  prb_node **link = &t->head.root;
+  prb_node *z;
+  for (;;) {  // prb_find와 같은 경로로 내려감
+    z = *link = own(*link);
+    path[d++] = z;
+    if (z->key == key) {
+      break;
+    }
+    link = (key < z->key) ? &z->left : &z->right;
+  }
+
+  // 자식이 둘이면 successor의 key를 z로 옮기고 successor 노드를 대신 뺌
+  // (persistent 모드는 node pointer를 돌려주지 않으므로 노드를 옮길 필요가 없음)
+  prb_node *y = z;
+  if (z->left != NULL && z->right != NULL) {
+    link = &z->right;
+    for (;;) {
+      y = *link = own(*link);
+      path[d++] = y;
+      if (y->left == NULL) {
+        break;
+      }
+      link = &y->left;
+    }
+    z->key = y->key;
+  }
+
+  // y는 자식이 하나 이하 : 그 자식 x가 y 자리를 대신함
+  prb_node *x = (y->left != NULL) ? y->left : y->right;
+  const int need_fixup = y->color == RBTREE_BLACK && !is_red(x);
+  if (y->color == RBTREE_BLACK && is_red(x)) {  // x를 BLACK으로 바꾸면 끝
+    x = own(x);
+    x->color = RBTREE_BLACK;
+  }
+  *link_to(t, path, d - 1) = x;
+  free(y);  // y는 단독 소유이고 x에 대한 참조는 새 부모가 넘겨받음
+  path[d - 1] = x;
+
+  if (need_fixup) {
+    prb_delete_fixup(t, path, d - 1);
+  }
+  t->head.count--;
+  pthread_mutex_unlock(&t->lock);
+  return 1;
+}
+
+size_t prbtree_size(prbtree *t) {
+  pthread_mutex_lock(&t->lock);
+  const size_t count = t->head.count;
+  pthread_mutex_unlock(&t->lock);
+  return count;
+}
+
+// 현재 버전의 root에 참조를 하나 더해 고정 : 이후 writer는 공유된 경로를 복사해서 고침
+const prb_version *prbtree_snapshot(prbtree *t) {
+  prb_version *v = (prb_version *)malloc(sizeof(prb_version));
+  pthread_mutex_lock(&t->lock);
+  *v = t->head;
+  node_retain(v->root);
+  pthread_mutex_unlock(&t->lock);
+  return v;
+}
+
+// 이 버전만 쓰던 노드들을 해제 (writer와 다른 snapshot이 쓰는 노드는 남음)
+void prbtree_release(const prb_version *v) {
+  node_release(v->root);
+  free((void *)v);
+}
+
+// key와 같은 노드를 반환, 없으면 NULL
+const prb_node *prb_find(const prb_version *v, const key_t key) {
+  const prb_node *x = v->root;
+  while (x != NULL) {
+    if (x->key == key) {
+      return x;
+    }
+    x = (x->key > key) ? x->left : x->right;
+  }
+  return NULL;
+}
+
+const prb_node *prb_min(const prb_version *v) {
+  const prb_node *x = v->root;
+  while (x != NULL && x->left != NULL) {
+    x = x->left;
+  }
+  return x;
+}
+
+const prb_node *prb_max(const prb_version *v) {
+  const prb_node *x = v->root;
+  while (x != NULL && x->right != NULL) {
+    x = x->right;
+  }
+  return x;
+}
+
+// key 순서대로 arr에 최대 n개 저장하고 저장한 개수를 반환
+size_t prb_to_array(const prb_version *v, key_t *arr, const size_t n) {
+  size_t idx = 0;
+  prb_cursor c;
+  for (prb_cursor_first(&c, v); prb_cursor_valid(&c) && idx < n; prb_cursor_next(&c)) {
+    arr[idx++] = prb_cursor_node(&c)->key;
+  }
+  return idx;
+}
+
+// parent pointer가 없으므로 아직 방문하지 않은 조상들을 stack에 쌓아둠
+static void push_left_spine(prb_cursor *c, const prb_node *x) {
+  while (x != NULL) {
+    c->stack[c->depth++] = x;
+    x = x->left;
+  }
+}
+
+void prb_cursor_first(prb_cursor *c, const prb_version *v) {
+  c->depth = 0;
+  push_left_spine(c, v->root);
+}
+
+// key 이상인 첫 노드에 위치 : 왼쪽으로 내려간 조상만 이후에 방문하면 되므로 그것만 쌓음
+void prb_cursor_seek(prb_cursor *c, const prb_version *v, const key_t key) {
+  c->depth = 0;
+  const prb_node *x = v->root;
+  while (x != NULL) {
+    if (x->key >= key) {
+      c->stack[c->depth++] = x;
+      x = x->left;
+    } else {
+      x = x->right;
+    }
+  }
+}
+
+int prb_cursor_valid(const prb_cursor *c) {
+  return c->depth > 0;
+}
+
+const prb_node *prb_cursor_node(const prb_cursor *c) {
+  return c->stack[c->depth - 1];
+}
+
+void prb_cursor_next(prb_cursor *c) {
+  const prb_node *x = c->stack[--c->depth];
+  push_left_spine(c, x->right);
+}
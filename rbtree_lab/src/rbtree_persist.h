@@ -0,0 +1,63 @@
+#ifndef _RBTREE_PERSIST_H_
+#define _RBTREE_PERSIST_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// Persistent (path-copying) red-black multiset. Nodes carry a reference
+// count instead of a parent pointer, so one node can be shared by several
+// versions. A writer copies only the nodes on the O(log n) path it changes
+// that are still shared with a snapshot; unshared nodes are updated in place.
+typedef struct prb_node {
+  color_t color;
+  key_t key;
+  unsigned int refs;  // versions and parent nodes pointing here
+  struct prb_node *left, *right;
+} prb_node;
+
+// An immutable version: a root plus its key count. NULL is the empty tree.
+typedef struct {
+  prb_node *root;
+  size_t count;
+} prb_version;
+
+typedef struct {
+  prb_version head;      // the writer's working version
+  pthread_mutex_t lock;  // held by writers and by prbtree_snapshot
+} prbtree;
+
+// tree height is at most 2 * log2(n + 1), plus room for one fixup rotation
+#define PRB_MAX_HEIGHT 130
+
+// in-order scan of one version without parent pointers
+typedef struct {
+  const prb_node *stack[PRB_MAX_HEIGHT];
+  int depth;  // 0 once the scan runs off the end
+} prb_cursor;
+
+prbtree *new_prbtree(void);
+void delete_prbtree(prbtree *);
+
+void prbtree_insert(prbtree *, const key_t);
+int prbtree_erase(prbtree *, const key_t);
+size_t prbtree_size(prbtree *);
+
+// O(1): pins the current version until prbtree_release, safe from any thread
+const prb_version *prbtree_snapshot(prbtree *);
+void prbtree_release(const prb_version *);
+
+// read-only queries on a snapshot (or on &t->head from the writer thread)
+const prb_node *prb_find(const prb_version *, const key_t);
+const prb_node *prb_min(const prb_version *);
+const prb_node *prb_max(const prb_version *);
+size_t prb_to_array(const prb_version *, key_t *, const size_t);
+
+void prb_cursor_first(prb_cursor *, const prb_version *);
+void prb_cursor_seek(prb_cursor *, const prb_version *, const key_t);  // first key >= given key
+int prb_cursor_valid(const prb_cursor *);
+const prb_node *prb_cursor_node(const prb_cursor *);
+void prb_cursor_next(prb_cursor *);
+
+#endif  // _RBTREE_PERSIST_H_
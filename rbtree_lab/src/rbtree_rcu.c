@@ -0,0 +1,305 @@
+#include "rbtree_rcu.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// red-black tree의 높이는 2*log2(n+1) 이하이므로 한 버전 안의 경로는 이보다 길 수 없음
+#define RCU_MAX_HEIGHT 128
+
+// reader가 노드의 필드를 읽을 때 쓰는 매크로 : writer가 동시에 고치고 있을 수 있으므로 atomic으로 읽고,
+// 읽은 값은 read_valid로 확인한 뒤에만 쓴다.
+#define LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+// 동작 방식
+// - writer는 트리를 고치는 동안 seq를 홀수로 둔다. reader는 시작할 때 읽은 짝수 seq가 그대로인지
+//   포인터를 하나 읽을 때마다 확인하므로, 확인을 통과한 포인터는 모두 같은 (완성된) 버전의 노드를 가리킨다.
+// - 떼어낸 노드는 바로 해제하지 않고 그때의 epoch와 함께 retired에 모아 둔다.
+//   reader는 호출하는 동안 자기 handle에 시작할 때의 epoch를 적어 두며, writer는 모든 reader의 epoch보다
+//   앞선 epoch에 떼어낸 노드만 해제한다. (그 reader들은 노드를 떼어낸 뒤의 버전만 볼 수 있음)
+// - reader는 자기 handle 외에는 아무것도 쓰지 않는다.
+
+rcu_rbtree *new_rcu_rbtree(void) {
+  rcu_rbtree *t = (rcu_rbtree *)calloc(1, sizeof(rcu_rbtree));
+  t->tree = new_rbtree();
+  t->epoch = 1;  // 0은 쉬고 있는 reader를 뜻함
+  pthread_mutex_init(&t->lock, NULL);
+  return t;
+}
+
+void delete_rcu_rbtree(rcu_rbtree *t) {
+  for (size_t i = 0; i < t->nretired; i++) {
+    rbtree_free_node(t->tree, t->retired[i].node);
+  }
+  free(t->retired);
+  delete_rbtree(t->tree);
+  pthread_mutex_destroy(&t->lock);
+  free(t);
+}
+
+// ---- writer ----
+
+static void write_begin(rcu_rbtree *t) {
+  __atomic_store_n(&t->seq, t->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);  // 홀수 seq가 트리의 어떤 변경보다 먼저 보이도록
+}
+
+static void write_end(rcu_rbtree *t) {
+  // seq_cst : 이후 reclaim에서 쉬는 것으로 보인 reader는 반드시 이 seq 이후부터 읽게 됨
+  __atomic_store_n(&t->seq, t->seq + 1, __ATOMIC_SEQ_CST);
+}
+
+// 떼어낸 노드를 현재 epoch로 기록하고 epoch를 넘김
+static void retire(rcu_rbtree *t, node_t *p) {
+  if (t->nretired == t->retired_cap) {
+    t->retired_cap = (t->retired_cap > 0) ? t->retired_cap * 2 : 16;
+    t->retired = (rcu_retired *)realloc(t->retired, t->retired_cap * sizeof(rcu_retired));
+  }
+  t->retired[t->nretired++] = (rcu_retired){.node = p, .epoch = t->epoch};
+  __atomic_store_n(&t->epoch, t->epoch + 1, __ATOMIC_SEQ_CST);
+}
+
+// 지금 읽고 있는 모든 reader보다 앞선 epoch에 떼어낸 노드들을 해제
+static void reclaim(rcu_rbtree *t) {
+  if (t->nretired == 0) {
+    return;
+  }
+  size_t oldest = SIZE_MAX;
+  for (rcu_rbtree_reader *r = t->readers; r != NULL; r = r->next) {
+    const size_t e = __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST);
+    if (e != 0 && e < oldest) {
+      oldest = e;
+    }
+  }
+  size_t i = 0;
+  while (i < t->nretired && t->retired[i].epoch < oldest) {
+    rbtree_free_node(t->tree, t->retired[i].node);
+    i++;
+  }
+  memmove(t->retired, t->retired + i, (t->nretired - i) * sizeof(rcu_retired));
+  t->nretired -= i;
+}
+
+void rcu_rbtree_insert(rcu_rbtree *t, const key_t key) {
+  pthread_mutex_lock(&t->lock);
+  write_begin(t);
+  rbtree_insert(t->tree, key);
+  write_end(t);
+  pthread_mutex_unlock(&t->lock);
+}
+
+int rcu_rbtree_erase(rcu_rbtree *t, const key_t key) {
+  pthread_mutex_lock(&t->lock);
+  node_t *p = rbtree_find(t->tree, key);  // writer는 하나뿐이므로 검증 없이 읽어도 됨
+  if (p == NULL) {
+    pthread_mutex_unlock(&t->lock);
+    return 0;
+  }
+  write_begin(t);
+  node_t *q = rbtree_detach(t->tree, p);
+  write_end(t);
+  if (q != NULL) {
+    retire(t, q);
+  }
+  reclaim(t);
+  pthread_mutex_unlock(&t->lock);
+  return 1;
+}
+
+size_t rcu_rbtree_size(rcu_rbtree *t) {
+  pthread_mutex_lock(&t->lock);
+  const size_t n = rbtree_size(t->tree);
+  pthread_mutex_unlock(&t->lock);
+  return n;
+}
+
+// ---- reader ----
+
+rcu_rbtree_reader *rcu_rbtree_reader_new(rcu_rbtree *t) {
+  // handle마다 cache line 하나를 따로 써서 reader끼리 같은 줄에 쓰지 않도록 함
+  rcu_rbtree_reader *r = (rcu_rbtree_reader *)aligned_alloc(64, sizeof(rcu_rbtree_reader));
+  memset(r, 0, sizeof(rcu_rbtree_reader));
+  r->owner = t;
+  pthread_mutex_lock(&t->lock);
+  r->next = t->readers;
+  t->readers = r;
+  pthread_mutex_unlock(&t->lock);
+  return r;
+}
+
+void rcu_rbtree_reader_delete(rcu_rbtree_reader *r) {
+  rcu_rbtree *t = r->owner;
+  pthread_mutex_lock(&t->lock);
+  rcu_rbtree_reader **link = &t->readers;
+  while (*link != r) {
+    link = &(*link)->next;
+  }
+  *link = r->next;
+  pthread_mutex_unlock(&t->lock);
+  free(r);
+}
+
+// 호출을 시작할 때 현재 epoch를 자기 handle에 적어 writer가 지금 읽을 수 있는 노드를 해제하지 못하게 함
+static void read_enter(rcu_rbtree_reader *r) {
+  const size_t e = __atomic_load_n(&r->owner->epoch, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&r->epoch, e, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);  // 적은 epoch가 트리를 읽기 전에 writer에게 보이도록
+}
+
+static void read_exit(rcu_rbtree_reader *r) {
+  __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+}
+
+// writer가 쉬고 있을 때의 (짝수) seq를 반환
+static unsigned read_begin(const rcu_rbtree *t) {
+  unsigned s;
+  while ((s = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE)) & 1) {
+  }
+  return s;
+}
+
+// 지금까지 읽은 값이 모두 seq s인 버전의 것인지 확인
+static int read_valid(const rcu_rbtree *t, const unsigned s) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&t->seq, __ATOMIC_RELAXED) == s;
+}
+
+int rcu_rbtree_find(rcu_rbtree_reader *r, const key_t key) {
+  const rcu_rbtree *t = r->owner;
+  const node_t *nil = t->tree->nil;
+  read_enter(r);
+  for (;;) {
+    const unsigned s = read_begin(t);
+    node_t *x = LOAD(t->tree->root);
+    // 확인을 통과한 x는 살아 있는 노드이고 key는 바뀌지 않으므로 바로 읽어도 됨
+    while (read_valid(t, s)) {
+      if (x == nil) {
+        read_exit(r);
+        return 0;
+      }
+      const key_t k = LOAD(x->key);
+      if (k == key) {
+        read_exit(r);
+        return 1;
+      }
+      // 두 자식을 모두 읽고 고르면 분기 없이 (cmov) 컴파일됨 : 무작위 key에서는 분기 예측이 절반은 틀림
+      node_t *left = LOAD(x->left);
+      node_t *right = LOAD(x->right);
+      x = (key < k) ? left : right;
+    }
+  }
+}
+
+// 가장 왼쪽(left가 1) 또는 가장 오른쪽 노드의 key를 *out에 저장, 빈 트리면 0 반환
+// writer가 rbtree에 기억해 둔 끝 노드를 읽으므로 내려갈 필요 없이 포인터 하나만 확인하면 됨
+static int read_end(rcu_rbtree_reader *r, const int left, key_t *out) {
+  const rcu_rbtree *t = r->owner;
+  const node_t *nil = t->tree->nil;
+  read_enter(r);
+  for (;;) {
+    const unsigned s = read_begin(t);
+    node_t *x = left ? LOAD(t->tree->leftmost) : LOAD(t->tree->rightmost);
+    if (!read_valid(t, s)) {
+      continue;
+    }
+    // 확인을 통과한 x는 살아 있는 노드이고 key는 바뀌지 않음
+    if (x != nil) {
+      *out = LOAD(x->key);
+    }
+    read_exit(r);
+    return x != nil;
+  }
+}
+
+int rcu_rbtree_min(rcu_rbtree_reader *r, key_t *out) {
+  return read_end(r, 1, out);
+}
+
+int rcu_rbtree_max(rcu_rbtree_reader *r, key_t *out) {
+  return read_end(r, 0, out);
+}
+
+// 중간에 끊긴 범위 scan을 이어가기 위한 상태
+typedef struct {
+  key_t lo, hi;
+  key_t *arr;
+  size_t n, idx;
+  key_t last;  // 마지막으로 저장한 key (idx > 0일 때만 의미 있음)
+  size_t dup;  // 지금까지 저장한 last의 개수, 다시 시작하면 같은 key를 이만큼 건너뜀
+} range_scan;
+
+// seq s인 버전에서 scan을 이어가고, 끝까지 마쳤으면 1, writer 때문에 끊겼으면 0 반환
+static int scan_once(const rcu_rbtree *t, const unsigned s, range_scan *sc) {
+  const node_t *nil = t->tree->nil;
+  const key_t from = (sc->idx > 0) ? sc->last : sc->lo;
+  size_t skip = (sc->idx > 0) ? sc->dup : 0;
+  node_t *stack[RCU_MAX_HEIGHT];
+  int top = 0;
+
+  // from 이상인 첫 key까지 내려가며, 왼쪽으로 내려간 조상들을 쌓음
+  node_t *x = LOAD(t->tree->root);
+  for (;;) {
+    if (!read_valid(t, s)) {
+      return 0;
+    }
+    if (x == nil) {
+      break;
+    }
+    if (LOAD(x->key) >= from) {
+      stack[top++] = x;
+      x = LOAD(x->left);
+    } else {
+      x = LOAD(x->right);
+    }
+  }
+
+  while (top > 0 && sc->idx < sc->n) {
+    x = stack[--top];
+    const key_t k = LOAD(x->key);
+    if (k > sc->hi) {
+      return 1;
+    }
+#ifdef RBTREE_COUNTED
+    // 개수는 writer가 제자리에서 바꾸므로 확인한 뒤에 씀
+    const size_t copies = LOAD(x->copies);
+    if (!read_valid(t, s)) {
+      return 0;
+    }
+#else
+    const size_t copies = 1;
+#endif
+    for (size_t c = 0; c < copies && sc->idx < sc->n; c++) {
+      if (k == from && skip > 0) {
+        skip--;  // 끊기기 전에 이미 저장한 key
+      } else {
+        sc->dup = (sc->idx > 0 && k == sc->last) ? sc->dup + 1 : 1;
+        sc->last = k;
+        sc->arr[sc->idx++] = k;
+      }
+    }
+    node_t *y = LOAD(x->right);
+    for (;;) {
+      if (!read_valid(t, s)) {
+        return 0;
+      }
+      if (y == nil) {
+        break;
+      }
+      stack[top++] = y;
+      y = LOAD(y->left);
+    }
+  }
+  return 1;
+}
+
+size_t rcu_rbtree_range(rcu_rbtree_reader *r, const key_t lo, const key_t hi, key_t *arr, const size_t n) {
+  range_scan sc = {.lo = lo, .hi = hi, .arr = arr, .n = n};
+  if (lo > hi) {
+    return 0;
+  }
+  read_enter(r);
+  while (!scan_once(r->owner, read_begin(r->owner), &sc)) {
+  }
+  read_exit(r);
+  return sc.idx;
+}
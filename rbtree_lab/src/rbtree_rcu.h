@@ -0,0 +1,60 @@
+#ifndef _RBTREE_RCU_H_
+#define _RBTREE_RCU_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// An rbtree shared by one writer and any number of reader threads that take
+// no lock. The writer bumps seq to an odd value around every change; readers
+// load each pointer, then check that seq still holds the even value they
+// started from, and restart the lookup otherwise, so they never follow a
+// pointer from a half-finished change and never write anything the writer or
+// other readers read. Erased nodes are only detached; they are freed once
+// every reader that could still hold them has finished its current call
+// (epoch-based reclamation).
+typedef struct rcu_rbtree_reader {
+  struct rcu_rbtree *owner;
+  size_t epoch;  // epoch seen on entry to the current call, 0 while idle
+  struct rcu_rbtree_reader *next;
+  char pad[64 - 2 * sizeof(void *) - sizeof(size_t)];  // one cache line per reader
+} rcu_rbtree_reader;
+
+typedef struct {
+  node_t *node;
+  size_t epoch;  // epoch in which the node was detached
+} rcu_retired;
+
+typedef struct rcu_rbtree {
+  rbtree *tree;
+  unsigned seq;   // odd while the writer is changing the tree
+  size_t epoch;   // advanced after every write that detached a node
+  pthread_mutex_t lock;  // writers, reader registration and reclamation
+  rcu_rbtree_reader *readers;
+  rcu_retired *retired;  // oldest first
+  size_t nretired, retired_cap;
+} rcu_rbtree;
+
+rcu_rbtree *new_rcu_rbtree(void);
+void delete_rcu_rbtree(rcu_rbtree *);  // no readers may be registered
+
+// writers, serialized by the tree's lock
+void rcu_rbtree_insert(rcu_rbtree *, const key_t);
+int rcu_rbtree_erase(rcu_rbtree *, const key_t);  // 1 if a copy was removed
+size_t rcu_rbtree_size(rcu_rbtree *);
+
+// one handle per reader thread
+rcu_rbtree_reader *rcu_rbtree_reader_new(rcu_rbtree *);
+void rcu_rbtree_reader_delete(rcu_rbtree_reader *);
+
+// readers take no lock and store only to their own handle; keys are copied
+// out because nodes may be freed as soon as the call returns
+int rcu_rbtree_find(rcu_rbtree_reader *, const key_t);
+int rcu_rbtree_min(rcu_rbtree_reader *, key_t *);
+int rcu_rbtree_max(rcu_rbtree_reader *, key_t *);
+// keys in [lo, hi] in order, at most n; a scan interrupted by a write resumes
+// after the last key it copied, so it is not a snapshot of one version
+size_t rcu_rbtree_range(rcu_rbtree_reader *, const key_t, const key_t, key_t *, const size_t);
+
+#endif  // _RBTREE_RCU_H_
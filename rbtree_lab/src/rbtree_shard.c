@@ -0,0 +1,249 @@
+#include "rbtree_shard.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// shard 하나가 평균의 몇 배를 넘으면 경계를 다시 나눌지
+#define SHARD_SKEW_FACTOR 2
+// shard 당 평균 key 수가 이보다 적으면 재분배하지 않음 (작은 트리에서 잦은 재분배 방지)
+#define SHARD_REBALANCE_MIN 1024
+// shard 트리가 쓰는 pool chunk 크기
+#define SHARD_POOL_CHUNK 1024
+// 재분배로도 치우침이 풀리지 않았다면 전체 key 수가 이 비율(1/N)만큼 바뀐 뒤에만 다시 시도
+#define SHARD_RETRY_FRACTION 4
+
+static const rbtree_config shard_config = {.pool_chunk = SHARD_POOL_CHUNK};
+
+// key가 들어갈 shard를 찾는 함수 : lo <= key 인 마지막 shard (이진 탐색)
+static rbtree_shard *shard_for(const sharded_rbtree *s, const key_t key) {
+  size_t lo = 0, hi = s->nshards;  // 답은 [lo, hi) 안에 있음, shards[0].lo는 가장 작은 key
+  while (hi - lo > 1) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (s->shards[mid].lo <= key) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return &s->shards[lo];
+}
+
+// 새로운 sharded 트리 생성 : 처음에는 key 범위 전체를 균등하게 나눔
+sharded_rbtree *new_sharded_rbtree(const size_t nshards) {
+  sharded_rbtree *s = (sharded_rbtree *)calloc(1, sizeof(sharded_rbtree));
+
+  s->nshards = (nshards > 0) ? nshards : 1;
+  s->shards = (rbtree_shard *)calloc(s->nshards, sizeof(rbtree_shard));
+  pthread_rwlock_init(&s->layout, NULL);
+
+  const int64_t span = (int64_t)INT_MAX - (int64_t)INT_MIN + 1;
+  for (size_t i = 0; i < s->nshards; i++) {
+    s->shards[i].tree = new_rbtree_ex(&shard_config);
+    s->shards[i].lo = (key_t)((int64_t)INT_MIN + span / (int64_t)s->nshards * (int64_t)i);
+    pthread_mutex_init(&s->shards[i].lock, NULL);
+  }
+  return s;
+}
+
+void delete_sharded_rbtree(sharded_rbtree *s) {
+  for (size_t i = 0; i < s->nshards; i++) {
+    delete_rbtree(s->shards[i].tree);
+    pthread_mutex_destroy(&s->shards[i].lock);
+  }
+  pthread_rwlock_destroy(&s->layout);
+  free(s->shards);
+  free(s);
+}
+
+// 가장 큰 shard가 평균의 SHARD_SKEW_FACTOR배를 넘었는지 확인 (layout 잠금을 잡은 상태에서 호출)
+static int over_limit(const sharded_rbtree *s, const size_t largest, const size_t total) {
+  return total >= SHARD_REBALANCE_MIN * s->nshards && largest * s->nshards > SHARD_SKEW_FACTOR * total;
+}
+
+// 재분배할 만큼 치우쳤는지 확인 (layout 잠금을 잡은 상태에서 호출)
+// 같은 key는 한 shard에 모이므로, 한 key가 전체의 SHARD_SKEW_FACTOR/N을 넘으면 어떻게 나눠도 한계를 넘는다.
+// 그런 상태에서 삽입마다 O(n) 재분배를 반복하지 않도록, 마지막으로 실패한 뒤 key 수가 충분히 바뀌었을 때만 다시 시도한다.
+static int is_skewed(const sharded_rbtree *s, const size_t largest) {
+  const size_t total = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+  if (!over_limit(s, largest, total)) {
+    return 0;
+  }
+  const size_t stuck = s->stuck_total;
+  const size_t moved = (total > stuck) ? total - stuck : stuck - total;
+  return stuck == 0 || moved * SHARD_RETRY_FRACTION >= stuck;
+}
+
+// 모든 key를 순서대로 모은 뒤 개수가 균등하도록 경계를 다시 정하고 shard 트리를 새로 만듦
+// layout 쓰기 잠금을 잡은 상태에서 호출해야 함
+static void rebalance_locked(sharded_rbtree *s) {
+  size_t total = 0;
+  for (size_t i = 0; i < s->nshards; i++) {
+    total += rbtree_size(s->shards[i].tree);
+  }
+  key_t *arr = (key_t *)malloc((total > 0 ? total : 1) * sizeof(key_t));
+
+  // shard들은 key 범위 순서대로 놓여 있으므로 이어 붙이면 전체가 정렬됨
+  size_t filled = 0;
+  for (size_t i = 0; i < s->nshards; i++) {
+    const size_t size = rbtree_size(s->shards[i].tree);
+    rbtree_to_array(s->shards[i].tree, arr + filled, size);
+    filled += size;
+    delete_rbtree(s->shards[i].tree);
+  }
+
+  size_t begin = 0, largest = 0;
+  for (size_t i = 0; i < s->nshards; i++) {
+    // 다음 shard의 경계 : i+1번째 분위수 key, 같은 key가 경계에 걸치면 모두 다음 shard로
+    size_t end = total;
+    if (i + 1 < s->nshards) {
+      const size_t q = total / s->nshards * (i + 1);
+      s->shards[i + 1].lo = (q < total) ? arr[q] : s->shards[i].lo;
+      if (s->shards[i + 1].lo < s->shards[i].lo) {
+        s->shards[i + 1].lo = s->shards[i].lo;
+      }
+      end = begin;
+      while (end < total && arr[end] < s->shards[i + 1].lo) {
+        end++;
+      }
+    }
+    // 처음 만들 때와 같은 pool 설정으로 다시 만듦
+    s->shards[i].tree = rbtree_from_sorted_ex(arr + begin, end - begin, &shard_config);
+    largest = (end - begin > largest) ? end - begin : largest;
+    begin = end;
+  }
+  free(arr);
+
+  s->stuck_total = over_limit(s, largest, total) ? total : 0;
+  s->rebalances++;
+}
+
+// 강제로 경계를 다시 나누는 함수
+void sharded_rbtree_rebalance(sharded_rbtree *s) {
+  pthread_rwlock_wrlock(&s->layout);
+  rebalance_locked(s);
+  pthread_rwlock_unlock(&s->layout);
+}
+
+// 쓰기 잠금을 잡은 뒤에도 여전히 치우쳐 있을 때만 재분배 (다른 스레드가 먼저 했을 수 있음)
+static void maybe_rebalance(sharded_rbtree *s) {
+  pthread_rwlock_wrlock(&s->layout);
+  size_t largest = 0;
+  for (size_t i = 0; i < s->nshards; i++) {
+    const size_t size = rbtree_size(s->shards[i].tree);
+    largest = (size > largest) ? size : largest;
+  }
+  if (is_skewed(s, largest)) {
+    rebalance_locked(s);
+  }
+  pthread_rwlock_unlock(&s->layout);
+}
+
+void sharded_rbtree_insert(sharded_rbtree *s, const key_t key) {
+  pthread_rwlock_rdlock(&s->layout);
+  rbtree_shard *shard = shard_for(s, key);
+
+  pthread_mutex_lock(&shard->lock);
+  rbtree_insert(shard->tree, key);
+  const size_t size = rbtree_size(shard->tree);
+  pthread_mutex_unlock(&shard->lock);
+
+  __atomic_add_fetch(&s->count, 1, __ATOMIC_RELAXED);
+  const int skewed = is_skewed(s, size);
+  pthread_rwlock_unlock(&s->layout);
+
+  if (skewed) {
+    maybe_rebalance(s);
+  }
+}
+
+// key가 있으면 1, 없으면 0
+int sharded_rbtree_find(sharded_rbtree *s, const key_t key) {
+  pthread_rwlock_rdlock(&s->layout);
+  rbtree_shard *shard = shard_for(s, key);
+
+  pthread_mutex_lock(&shard->lock);
+  const int found = rbtree_find(shard->tree, key) != NULL;
+  pthread_mutex_unlock(&shard->lock);
+
+  pthread_rwlock_unlock(&s->layout);
+  return found;
+}
+
+// key 하나를 지우고 1 반환, 없으면 0
+int sharded_rbtree_erase(sharded_rbtree *s, const key_t key) {
+  pthread_rwlock_rdlock(&s->layout);
+  rbtree_shard *shard = shard_for(s, key);
+
+  pthread_mutex_lock(&shard->lock);
+  node_t *p = rbtree_find(shard->tree, key);
+  if (p != NULL) {
+    rbtree_erase(shard->tree, p);
+    __atomic_sub_fetch(&s->count, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&shard->lock);
+
+  pthread_rwlock_unlock(&s->layout);
+  return p != NULL;
+}
+
+// 비어있지 않은 첫 shard의 최솟값을 out에 저장, 전체가 비어있으면 0 반환
+int sharded_rbtree_min(sharded_rbtree *s, key_t *out) {
+  int found = 0;
+  pthread_rwlock_rdlock(&s->layout);
+  for (size_t i = 0; i < s->nshards && !found; i++) {
+    pthread_mutex_lock(&s->shards[i].lock);
+    if (rbtree_size(s->shards[i].tree) > 0) {
+      *out = rbtree_min(s->shards[i].tree)->key;
+      found = 1;
+    }
+    pthread_mutex_unlock(&s->shards[i].lock);
+  }
+  pthread_rwlock_unlock(&s->layout);
+  return found;
+}
+
+// 비어있지 않은 마지막 shard의 최댓값을 out에 저장, 전체가 비어있으면 0 반환
+int sharded_rbtree_max(sharded_rbtree *s, key_t *out) {
+  int found = 0;
+  pthread_rwlock_rdlock(&s->layout);
+  for (size_t i = s->nshards; i > 0 && !found; i--) {
+    pthread_mutex_lock(&s->shards[i - 1].lock);
+    if (rbtree_size(s->shards[i - 1].tree) > 0) {
+      *out = rbtree_max(s->shards[i - 1].tree)->key;
+      found = 1;
+    }
+    pthread_mutex_unlock(&s->shards[i - 1].lock);
+  }
+  pthread_rwlock_unlock(&s->layout);
+  return found;
+}
+
+size_t sharded_rbtree_size(sharded_rbtree *s) {
+  return __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+}
+
+// 전체 key를 순서대로 arr에 최대 n개 저장하고 저장한 개수를 반환
+// 모든 shard를 순서대로 잠근 뒤 복사하므로 한 시점의 일관된 내용이 나옴
+size_t sharded_rbtree_to_array(sharded_rbtree *s, key_t *arr, const size_t n) {
+  size_t filled = 0;
+  pthread_rwlock_rdlock(&s->layout);
+  for (size_t i = 0; i < s->nshards; i++) {
+    pthread_mutex_lock(&s->shards[i].lock);
+  }
+
+  for (size_t i = 0; i < s->nshards && filled < n; i++) {
+    size_t size = rbtree_size(s->shards[i].tree);
+    if (size > n - filled) {
+      size = n - filled;
+    }
+    rbtree_to_array(s->shards[i].tree, arr + filled, size);
+    filled += size;
+  }
+
+  for (size_t i = s->nshards; i > 0; i--) {
+    pthread_mutex_unlock(&s->shards[i - 1].lock);
+  }
+  pthread_rwlock_unlock(&s->layout);
+  return filled;
+}
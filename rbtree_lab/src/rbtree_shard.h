@@ -0,0 +1,43 @@
+#ifndef _RBTREE_SHARD_H_
+#define _RBTREE_SHARD_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// Ordered multiset split into range shards, each an independent rbtree with
+// its own lock, so writers touching different key ranges run in parallel.
+// Shard i holds the keys in [shards[i].lo, shards[i + 1].lo).
+typedef struct {
+  rbtree *tree;
+  key_t lo;  // smallest key routed to this shard
+  pthread_mutex_t lock;
+} rbtree_shard;
+
+typedef struct {
+  rbtree_shard *shards;
+  size_t nshards;
+  size_t count;             // total keys, updated atomically
+  pthread_rwlock_t layout;  // shared by every operation, exclusive while rebalancing
+  // total at the last rebalance that left a shard over the limit (a run of
+  // equal keys cannot be split), 0 if none; no automatic retry until the
+  // total has moved away from it by 1/SHARD_RETRY_FRACTION
+  size_t stuck_total;
+  size_t rebalances;  // rebuilds done so far
+} sharded_rbtree;
+
+sharded_rbtree *new_sharded_rbtree(const size_t nshards);
+void delete_sharded_rbtree(sharded_rbtree *);
+
+void sharded_rbtree_insert(sharded_rbtree *, const key_t);
+int sharded_rbtree_find(sharded_rbtree *, const key_t);
+int sharded_rbtree_erase(sharded_rbtree *, const key_t);
+int sharded_rbtree_min(sharded_rbtree *, key_t *);
+int sharded_rbtree_max(sharded_rbtree *, key_t *);
+size_t sharded_rbtree_size(sharded_rbtree *);
+size_t sharded_rbtree_to_array(sharded_rbtree *, key_t *, const size_t);
+
+void sharded_rbtree_rebalance(sharded_rbtree *);
+
+#endif  // _RBTREE_SHARD_H_
@@ -1,8 +1,22 @@
 #include <assert.h>
+#include <crbtree.h>
+#include <pthread.h>
 #include <rbtree.h>
+#include <rbtree_bucket.h>
+#include <rbtree_frozen.h>
+#include <rbtree_generic.h>
+#include <rbtree_image.h>
+#include <rbtree_lean.h>
+#include <rbtree_persist.h>
+#include <rbtree_rcu.h>
+#include <rbtree_shard.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // new_rbtree should return rbtree struct with null root node
 void test_init(void)
@@ -83,6 +97,17 @@ static void insert_arr(rbtree *t, const key_t *arr, const size_t n)
   }
 }
 
+// number of keys held by a node, more than one only with -DRBTREE_COUNTED
+static size_t node_keys(const node_t *p)
+{
+#ifdef RBTREE_COUNTED
+  return p->copies;
+#else
+  (void)p;
+  return 1;
+#endif
+}
+
 static int comp(const void *p1, const void *p2)
 {
   const key_t *e1 = (const key_t *)p1;
@@ -412,18 +437,1989 @@ void test_find_erase_rand(const size_t n, const unsigned int seed)
   delete_rbtree(t);
 }
 
-int main(void)
+// pool-backed tree should behave the same as the malloc-backed one
+void test_pool_tree(const size_t n, const unsigned int seed)
 {
-  test_init();
-  test_insert_single(1024);
-  test_find_single(512, 1024);
-  test_erase_root(128);
-  test_find_erase_fixed();
-  test_minmax_suite();
-  test_to_array_suite();
-  test_distinct_values();
-  test_duplicate_values();
-  test_multi_instance();
-  test_find_erase_rand(10000, 17);
+  const rbtree_config config = {.pool_chunk = 64};
+  srand(seed);
+  rbtree *t = new_rbtree_ex(&config);
+  assert(t != NULL);
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (int i = 0; i < n; i++)
+  {
+    arr[i] = rand() % 1000;
+  }
+
+  // erased nodes go back to the pool and are reused by later inserts
+  test_find_erase(t, arr, n);
+  insert_arr(t, arr, n);
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  free(arr);
+  delete_rbtree(t);
+}
+
+// bulk-built trees should be valid rbtrees holding the given keys in order
+void test_from_array(const size_t max_n)
+{
+  for (size_t n = 0; n <= max_n; n++)
+  {
+    key_t *arr = calloc(n + 1, sizeof(key_t));
+    for (size_t i = 0; i < n; i++)
+    {
+      arr[i] = (key_t)((i * 7919) % 31);
+    }
+
+    rbtree *t = rbtree_from_array(arr, n);
+    assert(t != NULL);
+    test_color_constraint(t);
+    test_search_constraint(t);
+
+    qsort((void *)arr, n, sizeof(key_t), comp);
+    key_t *res = calloc(n + 1, sizeof(key_t));
+    rbtree_to_array(t, res, n);
+    for (size_t i = 0; i < n; i++)
+    {
+      assert(arr[i] == res[i]);
+    }
+
+    // the tree stays usable for regular updates
+    rbtree_insert(t, 15);
+    if (n > 0)
+    {
+      rbtree_erase(t, rbtree_min(t));
+    }
+    test_color_constraint(t);
+    test_search_constraint(t);
+
+    free(res);
+    free(arr);
+    delete_rbtree(t);
+  }
+
+  // the bulk block is sized for the input only, later inserts get ordinary chunks
+  const size_t big = 100000;
+  key_t *arr = calloc(big, sizeof(key_t));
+  for (size_t i = 0; i < big; i++)
+  {
+    arr[i] = (key_t)i;
+  }
+  rbtree *t = rbtree_from_sorted(arr, big);
+  rbtree_stats before, after;
+  rbtree_get_stats(t, &before);
+  assert(before.bytes_allocated >= big * sizeof(node_t) && before.bytes_allocated < (big + 64) * sizeof(node_t));
+  rbtree_insert(t, (key_t)big);
+  rbtree_get_stats(t, &after);
+  assert(after.bytes_allocated - before.bytes_allocated < big / 10 * sizeof(node_t));
+  test_color_constraint(t);
+  delete_rbtree(t);
+  free(arr);
+}
+
+// cursors should visit every key in order in both directions
+void test_cursor(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (int i = 0; i < n; i++)
+  {
+    arr[i] = rand() % 500;
+  }
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  rbtree_cursor c;
+  size_t i = 0;
+  for (rbtree_cursor_first(&c, t); rbtree_cursor_valid(&c); rbtree_cursor_next(&c))
+  {
+    assert(c.node->key == arr[i]);
+    i += node_keys(c.node);
+  }
+  assert(i == n);
+
+  for (rbtree_cursor_last(&c, t); rbtree_cursor_valid(&c); rbtree_cursor_prev(&c))
+  {
+    i -= node_keys(c.node);
+    assert(c.node->key == arr[i]);
+  }
+  assert(i == 0);
+
+  // scans can start from any node and stop early
+  node_t *p = rbtree_find(t, arr[n / 2]);
+  rbtree_cursor_at(&c, t, p);
+  for (int steps = 0; steps < 10 && rbtree_cursor_valid(&c); steps++)
+  {
+    node_t *next = rbtree_next(t, c.node);
+    assert(next == t->nil || next->key >= c.node->key);
+    assert(next == t->nil || rbtree_prev(t, next) == c.node);
+    rbtree_cursor_next(&c);
+  }
+
+  rbtree_cursor_at(&c, t, rbtree_find(t, -1));
+  assert(!rbtree_cursor_valid(&c));
+
+  free(arr);
+  delete_rbtree(t);
+}
+
+static int count_visit(node_t *p, void *arg)
+{
+  size_t *visited = (size_t *)arg;
+  (*visited)++;
+  return *visited == 3;
+}
+
+// bounds and range queries should match a scan of the sorted keys
+void test_bounds_range()
+{
+  key_t entries[] = {10, 5, 5, 34, 6, 23, 12, 12, 6, 12, 40, 1};
+  const size_t n = sizeof(entries) / sizeof(entries[0]);
+  rbtree *t = new_rbtree();
+  insert_arr(t, entries, n);
+  qsort((void *)entries, n, sizeof(key_t), comp);
+
+  for (key_t key = -1; key <= 42; key++)
+  {
+    size_t lo = 0, hi = 0;
+    while (lo < n && entries[lo] < key)
+    {
+      lo++;
+    }
+    hi = lo;
+    while (hi < n && entries[hi] <= key)
+    {
+      hi++;
+    }
+
+    node_t *p = rbtree_lower_bound(t, key);
+    node_t *q = rbtree_upper_bound(t, key);
+    assert(lo == n ? p == t->nil : p->key == entries[lo]);
+    assert(hi == n ? q == t->nil : q->key == entries[hi]);
+    // lower_bound lands on the first of several equal keys
+    assert(p == t->nil || rbtree_prev(t, p) == t->nil || rbtree_prev(t, p)->key < key);
+  }
+
+  key_t out[16];
+  size_t cnt = rbtree_range(t, 6, 13, out, 16);
+  assert(cnt == 6);
+  assert(out[0] == 6 && out[1] == 6 && out[2] == 10 && out[5] == 12);
+  assert(rbtree_range(t, 6, 13, out, 4) == 4);
+  assert(rbtree_range(t, 13, 6, out, 16) == 0);
+  assert(rbtree_range(t, 41, 100, out, 16) == 0);
+
+  size_t visited = 0;
+  assert(rbtree_range_foreach(t, 0, 100, count_visit, &visited) == 3);
+  assert(visited == 3);
+
+  delete_rbtree(t);
+}
+
+#ifndef RBTREE_NO_ORDER_STATS
+static size_t size_traverse(const node_t *p, const node_t *nil)
+{
+  if (p == nil)
+  {
+    return 0;
+  }
+  const size_t size = size_traverse(p->left, nil) + size_traverse(p->right, nil) + node_keys(p);
+  assert(p->size == size);
+  return size;
+}
+#endif
+
+// select/rank should agree with the sorted keys through inserts and erases
+void test_order_statistics(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (int i = 0; i < n; i++)
+  {
+    arr[i] = rand() % 200;
+  }
+  insert_arr(t, arr, n);
+
+  // erase every third key, then check against the remaining ones
+  size_t m = 0;
+  for (int i = 0; i < n; i++)
+  {
+    if (i % 3 == 0)
+    {
+      rbtree_erase(t, rbtree_find(t, arr[i]));
+    }
+    else
+    {
+      arr[m++] = arr[i];
+    }
+  }
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  assert(rbtree_size(t) == m);
+#ifndef RBTREE_NO_ORDER_STATS
+  assert(size_traverse(t->root, t->nil) == m);
+#endif
+
+  for (size_t k = 0; k < m; k++)
+  {
+    assert(rbtree_select(t, k)->key == arr[k]);
+  }
+  assert(rbtree_select(t, m) == t->nil);
+
+  size_t expected = 0;
+  for (key_t key = -1; key <= 201; key++)
+  {
+    while (expected < m && arr[expected] < key)
+    {
+      expected++;
+    }
+    assert(rbtree_rank(t, key) == expected);
+  }
+
+  free(arr);
+  delete_rbtree(t);
+
+  rbtree *s = rbtree_from_sorted((key_t[]){1, 2, 3, 4, 5, 6}, 6);
+  assert(rbtree_size(s) == 6);
+  assert(rbtree_select(s, 4)->key == 5);
+  assert(rbtree_rank(s, 4) == 3);
+  delete_rbtree(s);
+}
+
+static bool crb_color_traverse(const crbtree *t, const crb_index i, const int parent_red,
+                               const int black_depth)
+{
+  if (i == 0)
+  {
+    if (!touch_nil)
+    {
+      touch_nil = true;
+      max_black_depth = black_depth;
+    }
+    return black_depth == max_black_depth;
+  }
+  const int red = t->nodes[i].parent_color & 1;
+  if (parent_red && red)
+  {
+    return false;
+  }
+  const crb_node *p = &t->nodes[i];
+  if ((p->left != 0 && t->nodes[p->left].key > p->key) ||
+      (p->right != 0 && t->nodes[p->right].key < p->key))
+  {
+    return false;
+  }
+  return crb_color_traverse(t, p->left, red, black_depth + !red) &&
+         crb_color_traverse(t, p->right, red, black_depth + !red);
+}
+
+// the compact tree should behave like the pointer-based one
+void test_compact_tree(const size_t n, const unsigned int seed)
+{
+  assert(sizeof(crb_node) == 16);
+  srand(seed);
+  crbtree *t = new_crbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (int i = 0; i < n; i++)
+  {
+    arr[i] = rand() % 1000;
+    assert(crbtree_insert(t, arr[i]) != 0);
+  }
+
+  init_color_traverse();
+  assert(crb_color_traverse(t, t->root, 0, 0));
+
+  // erase half of the keys (pool slots get recycled by later inserts)
+  for (int i = 0; i < n / 2; i++)
+  {
+    crb_index p = crbtree_find(t, arr[i]);
+    assert(p != 0 && crbtree_key(t, p) == arr[i]);
+    crbtree_erase(t, p);
+  }
+  for (int i = 0; i < n / 4; i++)
+  {
+    crbtree_insert(t, arr[i]);
+  }
+  init_color_traverse();
+  assert(crb_color_traverse(t, t->root, 0, 0));
+
+  const size_t m = n - n / 2 + n / 4;
+  assert(crbtree_size(t) == m);
+  key_t *expected = calloc(m, sizeof(key_t));
+  for (size_t i = 0; i < m; i++)
+  {
+    expected[i] = i < n / 4 ? arr[i] : arr[i - n / 4 + n / 2];
+  }
+  qsort((void *)expected, m, sizeof(key_t), comp);
+
+  key_t *res = calloc(m, sizeof(key_t));
+  crbtree_to_array(t, res, m);
+  for (size_t i = 0; i < m; i++)
+  {
+    assert(res[i] == expected[i]);
+  }
+  assert(crbtree_key(t, crbtree_min(t)) == expected[0]);
+  assert(crbtree_key(t, crbtree_max(t)) == expected[m - 1]);
+  assert(crbtree_prev(t, crbtree_min(t)) == 0);
+  assert(crbtree_find(t, -5) == 0);
+
+  free(res);
+  free(expected);
+  free(arr);
+  delete_crbtree(t);
+
+  // a pool with every index in use refuses the insert and leaves the tree alone
+  // (the slot counters are faked, growing a real pool to 2^31 slots takes 32 GB)
+  t = new_crbtree();
+  crbtree_insert(t, 7);
+  const uint32_t capacity = t->capacity, used = t->used;
+  t->capacity = t->used = CRB_MAX_SLOTS;
+  assert(crbtree_insert(t, 8) == 0);
+  assert(crbtree_size(t) == 1 && crbtree_find(t, 8) == 0 && crbtree_key(t, t->root) == 7);
+  t->capacity = capacity;
+  t->used = used;
+  delete_crbtree(t);
+}
+
+typedef struct
+{
+  int hits;
+  double weight;
+} stat_value;
+
+RBTREE_DEFINE(u64_map, uint64_t, stat_value, RBTREE_CMP_NATIVE)
+
+static inline int prefix_cmp(const char *a, const char *b)
+{
+  return strncmp(a, b, 4);
+}
+
+RBTREE_DEFINE(prefix_map, const char *, int, prefix_cmp)
+
+// generated maps should keep typed keys in order and carry values
+void test_generic_map(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  u64_map *m = new_u64_map();
+  uint64_t *keys = calloc(n, sizeof(uint64_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    keys[i] = ((uint64_t)rand() << 32) | (uint64_t)rand();
+    u64_map_set(m, keys[i], (stat_value){(int)i, i * 0.5});
+  }
+  assert(u64_map_size(m) == n);
+
+  for (size_t i = 0; i < n; i++)
+  {
+    u64_map_node *p = u64_map_find(m, keys[i]);
+    assert(p != NULL && p->key == keys[i] && p->value.hits == (int)i);
+  }
+
+  // set overwrites instead of adding a duplicate
+  u64_map_set(m, keys[0], (stat_value){-1, 0});
+  assert(u64_map_size(m) == n);
+  assert(u64_map_find(m, keys[0])->value.hits == -1);
+
+  for (size_t i = 0; i < n; i += 2)
+  {
+    u64_map_erase(m, u64_map_find(m, keys[i]));
+  }
+  uint64_t prev = 0;
+  size_t seen = 0;
+  for (u64_map_node *p = u64_map_min(m); p != NULL; p = u64_map_next(m, p))
+  {
+    assert(seen == 0 || prev <= p->key);
+    prev = p->key;
+    seen++;
+  }
+  assert(seen == u64_map_size(m) && seen == n / 2);
+  free(keys);
+  delete_u64_map(m);
+
+  prefix_map *pm = new_prefix_map();
+  prefix_map_set(pm, "alpha", 1);
+  prefix_map_set(pm, "beta", 2);
+  prefix_map_set(pm, "alphabet", 3);  // same 4-byte prefix as "alpha"
+  assert(prefix_map_size(pm) == 2);
+  assert(prefix_map_find(pm, "alph")->value == 3);
+  assert(prefix_map_find(pm, "gamma") == NULL);
+  assert(strcmp(prefix_map_lower_bound(pm, "b")->key, "beta") == 0);
+  delete_prefix_map(pm);
+}
+
+typedef struct
+{
+  sharded_rbtree *s;
+  key_t base;
+  size_t n;
+} shard_writer_arg;
+
+static void *shard_writer(void *p)
+{
+  const shard_writer_arg *arg = (const shard_writer_arg *)p;
+  for (size_t i = 0; i < arg->n; i++)
+  {
+    // all writers hit a narrow key range so the shards get skewed
+    sharded_rbtree_insert(arg->s, arg->base + (key_t)(i % 5000));
+  }
+  return NULL;
+}
+
+// concurrent writers should end up with every key, in global order
+void test_sharded_tree(const size_t nthreads, const size_t per_thread)
+{
+  sharded_rbtree *s = new_sharded_rbtree(8);
+  pthread_t threads[8];
+  shard_writer_arg args[8];
+  for (size_t i = 0; i < nthreads; i++)
+  {
+    args[i] = (shard_writer_arg){s, (key_t)(i * 1000), per_thread};
+    pthread_create(&threads[i], NULL, shard_writer, &args[i]);
+  }
+  for (size_t i = 0; i < nthreads; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  const size_t n = nthreads * per_thread;
+  assert(sharded_rbtree_size(s) == n);
+
+  // skewed input was spread back out across the shards
+  size_t largest = 0;
+  for (size_t i = 0; i < s->nshards; i++)
+  {
+    const size_t size = rbtree_size(s->shards[i].tree);
+    largest = size > largest ? size : largest;
+    assert(i == 0 || s->shards[i - 1].lo <= s->shards[i].lo);
+  }
+  assert(largest * s->nshards <= 2 * n + s->nshards * 1024);
+
+  key_t *res = calloc(n, sizeof(key_t));
+  assert(sharded_rbtree_to_array(s, res, n) == n);
+  for (size_t i = 1; i < n; i++)
+  {
+    assert(res[i - 1] <= res[i]);
+  }
+
+  key_t lo, hi;
+  assert(sharded_rbtree_min(s, &lo) && lo == res[0]);
+  assert(sharded_rbtree_max(s, &hi) && hi == res[n - 1]);
+  assert(sharded_rbtree_find(s, 1234));
+  assert(!sharded_rbtree_find(s, -1));
+  assert(sharded_rbtree_erase(s, res[0]));
+  assert(!sharded_rbtree_erase(s, -1));
+  assert(sharded_rbtree_size(s) == n - 1);
+
+  free(res);
+  delete_sharded_rbtree(s);
+
+  // one key making up a third of the tree cannot be split across shards; a
+  // rebuild that cannot fix the skew must not be retried on every insert
+  s = new_sharded_rbtree(8);
+  const size_t m = 60000;
+  for (size_t i = 0; i < m; i++)
+  {
+    sharded_rbtree_insert(s, (i % 3 == 0) ? 42 : (key_t)i);
+  }
+  assert(sharded_rbtree_size(s) == m && s->rebalances > 0 && s->rebalances < 40);
+  assert(sharded_rbtree_erase(s, 42) && sharded_rbtree_find(s, 42));
+
+  // rebuilt shards keep growing by pool chunks, not by their rebuilt size
+  rbtree_stats before, after;
+  rbtree_shard *big = &s->shards[0];
+  for (size_t i = 1; i < s->nshards; i++)
+  {
+    big = rbtree_size(s->shards[i].tree) > rbtree_size(big->tree) ? &s->shards[i] : big;
+  }
+  rbtree_get_stats(big->tree, &before);
+  node_t *p = rbtree_insert(big->tree, rbtree_max(big->tree)->key);
+  rbtree_get_stats(big->tree, &after);
+  assert(after.bytes_allocated - before.bytes_allocated <= 2048 * sizeof(node_t));
+  rbtree_erase(big->tree, p);
+  delete_sharded_rbtree(s);
+}
+
+// batch inserts should match one-by-one inserts and keep node pointers valid
+void test_insert_many(const unsigned int seed)
+{
+  srand(seed);
+  const size_t sizes[] = {0, 1, 10, 1000, 100000};
+  const size_t batches[] = {1, 7, 500, 70000};
+  // pooled trees make the union path absorb the batch's pool
+  const rbtree_config pooled = {.pool_chunk = 64};
+  for (size_t a = 0; a < sizeof(sizes) / sizeof(sizes[0]); a++)
+  {
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+    {
+      const size_t n = sizes[a], m = batches[b];
+      rbtree *t = (b % 2) ? new_rbtree_ex(&pooled) : new_rbtree();
+      key_t *all = calloc(n + m, sizeof(key_t));
+      for (size_t i = 0; i < n + m; i++)
+      {
+        all[i] = rand() % 5000;
+      }
+      insert_arr(t, all, n);
+      node_t *kept = n > 0 ? rbtree_find(t, all[0]) : NULL;
+
+      rbtree_insert_many(t, all + n, m);
+      test_color_constraint(t);
+      test_search_constraint(t);
+      assert(rbtree_size(t) == n + m);
+      assert(kept == NULL || (rbtree_find(t, all[0]) != NULL && kept->key == all[0]));
+
+      qsort((void *)all, n + m, sizeof(key_t), comp);
+      key_t *res = calloc(n + m, sizeof(key_t));
+      rbtree_to_array(t, res, n + m);
+      for (size_t i = 0; i < n + m; i++)
+      {
+        assert(res[i] == all[i]);
+      }
+      for (size_t k = 0; k < n + m; k += 97)
+      {
+        assert(rbtree_select(t, k)->key == all[k]);
+      }
+      if (kept != NULL)
+      {
+        rbtree_erase(t, kept);
+        test_color_constraint(t);
+      }
+
+      free(res);
+      free(all);
+      delete_rbtree(t);
+    }
+  }
+}
+
+static void check_tree_keys(const rbtree *t, const key_t *expected, const size_t n)
+{
+  test_color_constraint(t);
+  test_search_constraint(t);
+  assert(rbtree_size(t) == n);
+#ifndef RBTREE_NO_ORDER_STATS
+  assert(size_traverse(t->root, t->nil) == n);
+#endif
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  rbtree_to_array(t, res, n);
+  for (size_t i = 0; i < n; i++)
+  {
+    assert(res[i] == expected[i]);
+  }
+  free(res);
+  // the cached ends must be the outermost nodes, not just nodes holding the same key
+  assert(n == 0 ? rbtree_min(t) == t->nil && rbtree_max(t) == t->nil
+                : rbtree_min(t)->key == expected[0] && rbtree_max(t)->key == expected[n - 1]);
+  assert(rbtree_prev(t, rbtree_min(t)) == t->nil && rbtree_next(t, rbtree_max(t)) == t->nil);
+}
+
+// split then join should give back the original keys
+// inserts 2000 more keys into a split half
+static void *split_grower(void *p)
+{
+  rbtree *t = p;
+  for (key_t k = 0; k < 2000; k++)
+  {
+    rbtree_insert(t, k % 300);
+  }
+  return NULL;
+}
+
+void test_split_join(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % 300;
+  }
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  for (key_t key = -1; key <= 301; key += 7)
+  {
+    const rbtree_config config = {.pool_chunk = (key % 2) ? 0 : 32};
+    rbtree *t = new_rbtree_ex(&config);
+    insert_arr(t, arr, n);
+
+    size_t cut = 0;
+    while (cut < n && arr[cut] < key)
+    {
+      cut++;
+    }
+    rbtree *r = rbtree_split(t, key);
+    check_tree_keys(t, arr, cut);
+    check_tree_keys(r, arr + cut, n - cut);
+
+    // both halves stay usable
+    node_t *p = rbtree_insert(r, 1000);
+    rbtree_erase(r, p);
+
+    // joins that would break key order are rejected
+    if (cut < n)
+    {
+      assert(rbtree_join(t, 1000, r) == -1);
+    }
+    if (cut > 0 && cut < n)
+    {
+      assert(rbtree_join(r, arr[cut], t) == -1);
+    }
+    const key_t pivot = cut > 0 ? arr[cut - 1] : key;
+    assert(rbtree_join(t, pivot, r) == 0);
+    assert(rbtree_size(r) == 0);
+
+    rbtree *expected = new_rbtree();
+    insert_arr(expected, arr, n);
+    rbtree_insert(expected, pivot);
+    key_t *keys = calloc(n + 1, sizeof(key_t));
+    rbtree_to_array(expected, keys, n + 1);
+    check_tree_keys(t, keys, n + 1);
+
+    free(keys);
+    delete_rbtree(expected);
+    delete_rbtree(r);
+    delete_rbtree(t);
+  }
+
+  // the split-off half gets its own allocator: both halves can grow on different
+  // threads, and the half it came from can go first while its chunks still hold nodes
+  rbtree *whole = rbtree_from_sorted(arr, n);
+  size_t cut = 0;
+  while (cut < n && arr[cut] < 150)
+  {
+    cut++;
+  }
+  rbtree *half = rbtree_split(whole, 150);
+  pthread_t grower;
+  pthread_create(&grower, NULL, split_grower, half);
+  split_grower(whole);
+  pthread_join(grower, NULL);
+  assert(rbtree_size(whole) == cut + 2000 && rbtree_size(half) == n - cut + 2000);
+  test_color_constraint(whole);
+  delete_rbtree(whole);
+  test_color_constraint(half);
+  test_search_constraint(half);
+  delete_rbtree(half);
+
+  // trees with unrelated pools can only be joined when the source owns its pool
+  const rbtree_config config = {.pool_chunk = 16};
+  rbtree *a = new_rbtree_ex(&config);
+  rbtree *b = new_rbtree_ex(&config);
+  rbtree *c = new_rbtree();
+  insert_arr(a, (key_t[]){1, 2, 3}, 3);
+  insert_arr(b, (key_t[]){7, 8, 9}, 3);
+  insert_arr(c, (key_t[]){10, 11}, 2);
+  assert(rbtree_join(b, 9, c) == -1);
+  assert(rbtree_join(a, 5, b) == 0);
+  delete_rbtree(b);
+  check_tree_keys(a, (key_t[]){1, 2, 3, 5, 7, 8, 9}, 7);
+  delete_rbtree(c);
+  delete_rbtree(a);
+  free(arr);
+}
+
+static size_t multiset_op(const key_t *a, const size_t na, const key_t *b, const size_t nb,
+                          const int op, key_t *out)
+{
+  size_t i = 0, j = 0, k = 0;
+  while (i < na || j < nb)
+  {
+    if (j == nb || (i < na && a[i] < b[j]))
+    {
+      if (op != 1)
+      {
+        out[k++] = a[i];
+      }
+      i++;
+    }
+    else if (i == na || b[j] < a[i])
+    {
+      if (op == 0)
+      {
+        out[k++] = b[j];
+      }
+      j++;
+    }
+    else
+    {
+      if (op == 0)
+      {
+        out[k++] = a[i];
+        out[k++] = b[j];
+      }
+      else if (op == 1)
+      {
+        out[k++] = a[i];
+      }
+      i++;
+      j++;
+    }
+  }
+  return k;
+}
+
+// union/intersection/difference should follow multiset counts
+void test_set_operations(const size_t na, const size_t nb, const unsigned int seed)
+{
+  srand(seed);
+  key_t *a = calloc(na + 1, sizeof(key_t));
+  key_t *b = calloc(nb + 1, sizeof(key_t));
+  key_t *expected = calloc(na + nb + 1, sizeof(key_t));
+  for (size_t i = 0; i < na; i++)
+  {
+    a[i] = rand() % 2000;
+  }
+  for (size_t i = 0; i < nb; i++)
+  {
+    b[i] = rand() % 2000;
+  }
+  qsort((void *)a, na, sizeof(key_t), comp);
+  qsort((void *)b, nb, sizeof(key_t), comp);
+
+  for (int op = 0; op < 3; op++)
+  {
+    const rbtree_config config = {.pool_chunk = op == 1 ? 0 : 128};
+    rbtree *t1 = new_rbtree_ex(&config);
+    rbtree *t2 = new_rbtree_ex(&config);
+    insert_arr(t1, a, na);
+    insert_arr(t2, b, nb);
+
+    int ret;
+    if (op == 0)
+    {
+      ret = rbtree_union(t1, t2);
+    }
+    else if (op == 1)
+    {
+      ret = rbtree_intersection(t1, t2);
+    }
+    else
+    {
+      ret = rbtree_difference(t1, t2);
+    }
+    assert(ret == 0);
+    assert(rbtree_size(t2) == 0);
+    check_tree_keys(t1, expected, multiset_op(a, na, b, nb, op, expected));
+
+    delete_rbtree(t2);
+    delete_rbtree(t1);
+  }
+
+  free(expected);
+  free(b);
+  free(a);
+}
+
+static bool prb_color_traverse(const prb_node *p, const int parent_red, const int black_depth)
+{
+  if (p == NULL)
+  {
+    if (!touch_nil)
+    {
+      touch_nil = true;
+      max_black_depth = black_depth;
+    }
+    return black_depth == max_black_depth;
+  }
+  const int red = p->color == RBTREE_RED;
+  if ((parent_red && red) || (p->left != NULL && p->left->key > p->key) ||
+      (p->right != NULL && p->right->key < p->key))
+  {
+    return false;
+  }
+  return prb_color_traverse(p->left, red, black_depth + !red) &&
+         prb_color_traverse(p->right, red, black_depth + !red);
+}
+
+// once no snapshot is held, every node is referenced by exactly one parent
+static bool prb_exclusive(const prb_node *p)
+{
+  return p == NULL || (p->refs == 1 && prb_exclusive(p->left) && prb_exclusive(p->right));
+}
+
+static void check_version(const prb_version *v, const key_t *expected, const size_t n)
+{
+  init_color_traverse();
+  assert(prb_color_traverse(v->root, 0, 0));
+  assert(v->count == n);
+
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert(prb_to_array(v, res, n + 1) == n);
+  for (size_t i = 0; i < n; i++)
+  {
+    assert(res[i] == expected[i]);
+  }
+  if (n > 0)
+  {
+    assert(prb_min(v)->key == expected[0]);
+    assert(prb_max(v)->key == expected[n - 1]);
+    assert(prb_find(v, expected[n / 2]) != NULL);
+
+    prb_cursor c;
+    prb_cursor_seek(&c, v, expected[n / 2]);
+    assert(prb_cursor_valid(&c) && prb_cursor_node(&c)->key == expected[n / 2]);
+  }
+  else
+  {
+    assert(prb_min(v) == NULL && prb_max(v) == NULL);
+  }
+  free(res);
+}
+
+typedef struct
+{
+  prbtree *t;
+  int stop;
+  size_t checked;
+} prb_reader_arg;
+
+// reader threads only ever see complete, sorted versions
+static void *prb_reader(void *p)
+{
+  prb_reader_arg *arg = (prb_reader_arg *)p;
+  while (!__atomic_load_n(&arg->stop, __ATOMIC_ACQUIRE))
+  {
+    const prb_version *v = prbtree_snapshot(arg->t);
+    size_t seen = 0;
+    key_t prev = 0;
+    prb_cursor c;
+    for (prb_cursor_first(&c, v); prb_cursor_valid(&c); prb_cursor_next(&c))
+    {
+      assert(seen == 0 || prev <= prb_cursor_node(&c)->key);
+      prev = prb_cursor_node(&c)->key;
+      seen++;
+    }
+    assert(seen == v->count);
+    prbtree_release(v);
+    arg->checked++;
+  }
+  return NULL;
+}
+
+// snapshots should stay unchanged while the writer keeps inserting and erasing
+void test_persistent_tree(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  prbtree *t = new_prbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % 1000;
+    prbtree_insert(t, arr[i]);
+  }
+  const prb_version *v1 = prbtree_snapshot(t);
+  key_t *exp1 = calloc(n, sizeof(key_t));
+  memcpy(exp1, arr, n * sizeof(key_t));
+  qsort((void *)exp1, n, sizeof(key_t), comp);
+
+  // erase the first half and insert fresh keys, then pin that version too
+  for (size_t i = 0; i < n / 2; i++)
+  {
+    assert(prbtree_erase(t, arr[i]) == 1);
+    arr[i] = 1000 + rand() % 1000;
+    prbtree_insert(t, arr[i]);
+  }
+  assert(prbtree_erase(t, -1) == 0);
+  const prb_version *v2 = prbtree_snapshot(t);
+  key_t *exp2 = calloc(n, sizeof(key_t));
+  memcpy(exp2, arr, n * sizeof(key_t));
+  qsort((void *)exp2, n, sizeof(key_t), comp);
+
+  for (size_t i = 0; i < n; i += 2)
+  {
+    assert(prbtree_erase(t, arr[i]) == 1);
+  }
+  check_version(v1, exp1, n);
+  check_version(v2, exp2, n);
+
+  prbtree_release(v1);
+  prbtree_release(v2);
+  assert(prb_exclusive(t->head.root));
+  for (size_t i = 1; i < n; i += 2)
+  {
+    assert(prbtree_erase(t, arr[i]) == 1);
+  }
+  check_version(&t->head, NULL, 0);
+  assert(t->head.root == NULL && prbtree_size(t) == 0);
+
+  // a snapshot may outlive its tree
+  prbtree_insert(t, 7);
+  const prb_version *v3 = prbtree_snapshot(t);
+  delete_prbtree(t);
+  assert(prb_find(v3, 7) != NULL && v3->count == 1);
+  prbtree_release(v3);
+
+  // one writer against a concurrent reader
+  t = new_prbtree();
+  prb_reader_arg arg = {t, 0, 0};
+  pthread_t reader;
+  pthread_create(&reader, NULL, prb_reader, &arg);
+  for (size_t i = 0; i < n; i++)
+  {
+    prbtree_insert(t, arr[i]);
+  }
+  for (size_t i = 0; i < n; i += 3)
+  {
+    assert(prbtree_erase(t, arr[i]) == 1);
+  }
+  __atomic_store_n(&arg.stop, 1, __ATOMIC_RELEASE);
+  pthread_join(reader, NULL);
+  assert(prb_exclusive(t->head.root));
+  delete_prbtree(t);
+
+  free(exp2);
+  free(exp1);
+  free(arr);
+}
+
+// a saved image should answer the same queries as the tree it came from
+void test_image(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  char path[] = "/tmp/rbtree-image-XXXXXX";
+  const int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n + 1, sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % 5000;
+    rbtree_insert(t, arr[i]);
+  }
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  assert(rbtree_save(t, path) == 0);
+
+  rbtree_image *img = rbtree_open_mmap(path);
+  assert(img != NULL && rbtree_image_verify(img) == 0);
+  assert(rbtree_image_size(img) == n);
+
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert(rbtree_image_to_array(img, res, n + 1) == n);
+  size_t i = 0;
+  for (const rbtree_image_node *p = rbtree_image_min(img); p != NULL; p = rbtree_image_next(img, p))
+  {
+    assert(res[i] == arr[i] && p->key == arr[i]);
+    i++;
+  }
+  assert(i == n);
+  for (i = 0; i < n; i++)
+  {
+    assert(rbtree_image_find(img, arr[i])->key == arr[i]);
+    const node_t *lb = rbtree_lower_bound(t, arr[i] + 1);
+    const rbtree_image_node *q = rbtree_image_lower_bound(img, arr[i] + 1);
+    assert(lb == t->nil ? q == NULL : q != NULL && q->key == lb->key);
+  }
+  assert(rbtree_image_find(img, -1) == NULL);
+  assert(rbtree_image_max(img)->key == arr[n - 1]);
+  assert(rbtree_image_prev(img, rbtree_image_min(img)) == NULL);
+  rbtree_close_mmap(img);
+
+  // flipping one key is caught by verify, chopping the file by open
+  FILE *f = fopen(path, "r+b");
+  fseek(f, sizeof(rbtree_image_header) + (n / 2) * sizeof(rbtree_image_node), SEEK_SET);
+  fputc(0x7f, f);
+  fclose(f);
+  img = rbtree_open_mmap(path);
+  assert(img != NULL && rbtree_image_verify(img) == -1);
+  rbtree_close_mmap(img);
+  assert(truncate(path, sizeof(rbtree_image_header) + sizeof(rbtree_image_node) / 2) == 0);
+  assert(rbtree_open_mmap(path) == NULL);
+
+  // an empty tree still round-trips, and saving it over an image that is still
+  // open replaces the file while the old mapping keeps reading the old image
+  assert(rbtree_save(t, path) == 0);
+  rbtree_image *old = rbtree_open_mmap(path);
+  assert(old != NULL);
+  const rbtree_image_node *last = rbtree_image_max(old);
+  rbtree *empty = new_rbtree();
+  assert(rbtree_save(empty, path) == 0);
+  assert(last->key == arr[n - 1] && rbtree_image_find(old, arr[n - 1]) != NULL);
+  assert(rbtree_image_size(old) == n && rbtree_image_verify(old) == 0);
+  rbtree_close_mmap(old);
+  img = rbtree_open_mmap(path);
+  assert(img != NULL && rbtree_image_verify(img) == 0);
+  assert(rbtree_image_size(img) == 0 && rbtree_image_min(img) == NULL);
+  assert(rbtree_image_lower_bound(img, 0) == NULL);
+  rbtree_close_mmap(img);
+  delete_rbtree(empty);
+
+  unlink(path);
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// shape stats in every build, hot-path counters only with -DRBTREE_STATS
+void test_stats(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, (key_t)i);  // ascending keys force rotations
+  }
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_find(t, rand() % (2 * (key_t)n));
+  }
+  for (size_t i = 0; i < n / 2; i++)
+  {
+    rbtree_erase(t, rbtree_find(t, (key_t)i));
+  }
+
+  rbtree_stats stats;
+  const int ret = rbtree_get_stats(t, &stats);
+  const size_t m = n - n / 2;
+  assert(stats.count == m);
+  assert(stats.bytes_allocated == m * sizeof(node_t));
+  int log2m = 0;
+  while (((size_t)1 << log2m) <= m)
+  {
+    log2m++;
+  }
+  assert(stats.height <= 2 * log2m && stats.black_height * 2 >= stats.height);
+
+#ifdef RBTREE_STATS
+  assert(ret == 0);
+  assert(stats.inserts == n && stats.erases == n / 2 && stats.finds == n + n / 2);
+  assert(stats.rotations > 0 && stats.recolors > 0);
+  assert(stats.insert_fixup_loops > 0 && stats.delete_fixup_loops > 0);
+  size_t total = 0;
+  for (int d = 0; d < RBTREE_DEPTH_BUCKETS; d++)
+  {
+    total += stats.find_depth[d];
+    assert(stats.find_depth[d] == 0 || d <= 2 * log2m + 2);  // no deeper than the tree was at n keys
+  }
+  assert(total == stats.finds);
+
+  rbtree_reset_stats(t);
+  rbtree_get_stats(t, &stats);
+  assert(stats.inserts == 0 && stats.rotations == 0 && stats.count == m);
+
+  // split and join rebalance through scratch trees; their work must still be counted
+  for (size_t i = 1; i < 16; i++)
+  {
+    const key_t cut = (key_t)(n / 2 + i * n / 32);
+    rbtree *r = rbtree_split(t, cut);
+    assert(rbtree_join(t, cut, r) == 0);
+    delete_rbtree(r);
+  }
+  rbtree_get_stats(t, &stats);
+  assert(stats.inserts == 0 && stats.rotations > 0 && stats.recolors > 0 && stats.insert_fixup_loops > 0);
+#else
+  assert(ret == -1 && stats.inserts == 0 && stats.rotations == 0);
+#endif
+  delete_rbtree(t);
+
+  const rbtree_config config = {.pool_chunk = 64};
+  rbtree *p = new_rbtree_ex(&config);
+  insert_arr(p, (key_t[]){3, 1, 2}, 3);
+  rbtree_get_stats(p, &stats);
+  assert(stats.bytes_allocated >= 64 * sizeof(node_t) && stats.height == 2 && stats.black_height == 1);
+  delete_rbtree(p);
+}
+
+// large exports are split across threads, the result must not change
+void test_to_array_large(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % (key_t)(n / 2);
+  }
+  rbtree *t = rbtree_from_array(arr, n / 2);
+  for (size_t i = n / 2; i < n; i++)
+  {
+    rbtree_insert(t, arr[i]);
+  }
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  const size_t limits[] = {n + 10, n, n - 1, n / 2 + 1, 70000, 5, 0};
+  key_t *res = calloc(n + 10, sizeof(key_t));
+  for (size_t l = 0; l < sizeof(limits) / sizeof(limits[0]); l++)
+  {
+    const size_t lim = limits[l];
+    for (size_t i = 0; i < n + 10; i++)
+    {
+      res[i] = -1;
+    }
+    rbtree_to_array(t, res, lim);
+    for (size_t i = 0; i < n + 10; i++)
+    {
+      assert(res[i] == (i < lim && i < n ? arr[i] : -1));
+    }
+  }
+
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// like check_tree_keys, for keys not given in order
+static void check_tree_keys_sorted(const rbtree *t, const key_t *keys, const size_t n)
+{
+  key_t *expected = calloc(n + 1, sizeof(key_t));
+  memcpy(expected, keys, n * sizeof(key_t));
+  qsort((void *)expected, n, sizeof(key_t), comp);
+  check_tree_keys(t, expected, n);
+  free(expected);
+}
+
+// hinted inserts must give the same multiset whether the hint is right or not
+void test_insert_hint(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *all = calloc(3 * n, sizeof(key_t));
+  node_t **nodes = calloc(3 * n, sizeof(node_t *));
+  size_t m = 0;
+
+  // nearly ascending stream with the last inserted node as the hint
+  node_t *hint = NULL;
+  for (size_t i = 0; i < n; i++)
+  {
+    const key_t key = (key_t)(i * 4) + rand() % 13;
+    hint = rbtree_insert_hint(t, hint, key);
+    assert(hint->key == key);
+    all[m] = key;
+    nodes[m++] = hint;
+  }
+  check_tree_keys_sorted(t, all, m);
+
+  // random hints (mostly wrong), duplicates, and no hint at all
+  for (size_t i = 0; i < n; i++)
+  {
+    const key_t key = rand() % (key_t)(4 * n);
+    node_t *h = (i % 5 == 0) ? NULL : nodes[rand() % m];
+    node_t *p = rbtree_insert_hint(t, h, (i % 3 == 0 && h != NULL) ? h->key : key);
+    all[m] = p->key;
+    nodes[m++] = p;
+  }
+  check_tree_keys_sorted(t, all, m);
+
+  // descending stream hinted with the previous (larger) node
+  hint = rbtree_min(t);
+  for (size_t i = 0; i < n; i++)
+  {
+    const key_t key = -(key_t)i;
+    hint = rbtree_insert_hint(t, hint, key);
+    all[m++] = key;
+  }
+  check_tree_keys_sorted(t, all, m);
+
+  free(nodes);
+  free(all);
+  delete_rbtree(t);
+}
+
+// heavily repeated keys: same multiset in every build, one node per key if counted
+void test_counted_multiset(const size_t n, const size_t distinct, const unsigned int seed)
+{
+  srand(seed);
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % (key_t)distinct;
+  }
+  rbtree *t = new_rbtree();
+  node_t *first = rbtree_insert(t, arr[0]);
+  insert_arr(t, arr + 1, n - 1);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  check_tree_keys(t, arr, n);
+
+  size_t nodes = 0;
+  for (node_t *p = rbtree_min(t); p != t->nil; p = rbtree_next(t, p))
+  {
+    nodes++;
+  }
+#ifdef RBTREE_COUNTED
+  assert(nodes <= distinct);
+  assert(rbtree_insert(t, first->key) == first);
+  rbtree_erase(t, first);
+#else
+  assert(nodes == n && first != NULL);
+#endif
+  for (size_t k = 0; k < n; k += 101)
+  {
+    assert(rbtree_select(t, k)->key == arr[k]);
+    assert(rbtree_rank(t, arr[k]) <= k && arr[rbtree_rank(t, arr[k])] == arr[k]);
+  }
+
+  // from_sorted and the bulk insert must give the same multiset
+  rbtree *u = rbtree_from_sorted(arr, n / 2);
+  rbtree_insert_many(u, arr + n / 2, n - n / 2);
+  check_tree_keys(u, arr, n);
+  delete_rbtree(u);
+
+  // join on a key that sits at both ends
+  const key_t mid = arr[n / 2];
+  rbtree *r = rbtree_split(t, mid);
+  assert(rbtree_join(t, mid, r) == 0);
+  key_t *joined = calloc(n + 1, sizeof(key_t));
+  memcpy(joined, arr, n * sizeof(key_t));
+  joined[n] = mid;
+  qsort((void *)joined, n + 1, sizeof(key_t), comp);
+  check_tree_keys(t, joined, n + 1);
+  assert(rbtree_erase(t, rbtree_find(t, mid)) == 0);
+  delete_rbtree(r);
+
+  // erase one occurrence at a time until empty
+  for (size_t i = 0; i < n; i++)
+  {
+    node_t *p = rbtree_find(t, arr[i]);
+    assert(p != NULL);
+    rbtree_erase(t, p);
+    assert(rbtree_size(t) == n - i - 1);
+  }
+  assert(t->root == t->nil);
+
+  free(joined);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// a frozen copy should answer the same queries as the tree it came from
+void test_frozen(const size_t max_n, const unsigned int seed)
+{
+  srand(seed);
+  const size_t sizes[] = {0, 1, 15, 16, 17, 300, 16 * 17 + 16, max_n};
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    const size_t n = sizes[s];
+    key_t *arr = calloc(n + 1, sizeof(key_t));
+    for (size_t i = 0; i < n; i++)
+    {
+      arr[i] = rand() % (key_t)(2 * n + 1) - (key_t)n;
+    }
+    if (n > 2)
+    {
+      arr[0] = INT32_MAX;  // the largest key must not be confused with padding
+      arr[1] = INT32_MIN;
+    }
+    rbtree *t = rbtree_from_array(arr, n);
+    qsort((void *)arr, n, sizeof(key_t), comp);
+    rbtree_frozen *f = rbtree_freeze(t);
+    assert(rbtree_frozen_size(f) == n);
+
+    key_t *res = calloc(n + 1, sizeof(key_t));
+    assert(rbtree_frozen_to_array(f, res, n + 1) == n);
+    for (size_t i = 0; i < n; i++)
+    {
+      assert(res[i] == arr[i]);
+    }
+    if (n > 0)
+    {
+      assert(rbtree_frozen_to_array(f, res, n / 2) == n / 2);
+      assert(*rbtree_frozen_min(f) == arr[0] && *rbtree_frozen_max(f) == arr[n - 1]);
+    }
+    else
+    {
+      assert(rbtree_frozen_min(f) == NULL && rbtree_frozen_max(f) == NULL);
+    }
+
+    // probes around every key plus the extremes
+    for (size_t i = 0; i <= n + 1; i++)
+    {
+      const key_t key = (i < n) ? arr[i] : (i == n ? INT32_MAX : INT32_MIN);
+      for (int d = -1; d <= 1; d++)
+      {
+        if ((d < 0 && key == INT32_MIN) || (d > 0 && key == INT32_MAX))
+        {
+          continue;
+        }
+        const key_t probe = key + d;
+        const node_t *lb = rbtree_lower_bound(t, probe);
+        const key_t *q = rbtree_frozen_lower_bound(f, probe);
+        assert(lb == t->nil ? q == NULL : q != NULL && *q == lb->key);
+        const key_t *found = rbtree_frozen_find(f, probe);
+        assert(rbtree_find(t, probe) == NULL ? found == NULL : found != NULL && *found == probe);
+      }
+    }
+
+    delete_rbtree_frozen(f);
+    free(res);
+    free(arr);
+    delete_rbtree(t);
+  }
+}
+
+// checks colors, black heights, parent links and bucket order of a bucket subtree;
+// returns its black height and counts its keys and buckets
+static int check_bucket_subtree(const brbtree *t, const brb_node *x, const key_t **last, size_t *keys, size_t *nodes)
+{
+  if (x == &t->nil)
+  {
+    return 1;
+  }
+  assert(x->left == &t->nil || x->left->parent == x);
+  assert(x->right == &t->nil || x->right->parent == x);
+  assert(x->color == RBTREE_BLACK || (x->left->color == RBTREE_BLACK && x->right->color == RBTREE_BLACK));
+  const int lh = check_bucket_subtree(t, x->left, last, keys, nodes);
+  assert(x->n >= 1 && x->n <= BRB_BUCKET);
+  for (uint32_t i = 0; i < x->n; i++)
+  {
+    assert(*last == NULL || **last <= x->keys[i]);
+    *last = &x->keys[i];
+  }
+  *keys += x->n;
+  (*nodes)++;
+  const int rh = check_bucket_subtree(t, x->right, last, keys, nodes);
+  assert(lh == rh);
+  return lh + (x->color == RBTREE_BLACK);
+}
+
+static void check_bucket_tree(const brbtree *t)
+{
+  const key_t *last = NULL;
+  size_t keys = 0, nodes = 0;
+  assert(t->root->color == RBTREE_BLACK);
+  check_bucket_subtree(t, t->root, &last, &keys, &nodes);
+  assert(keys == brbtree_size(t) && nodes == t->nodes);
+}
+
+// a bucket tree should hold the same multiset as a table of key counts
+void test_bucket_tree(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  const key_t range = (key_t)(n / 4 + 1);  // plenty of duplicates
+  size_t *counts = calloc(range, sizeof(size_t));
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  brbtree *t = new_brbtree();
+  assert(brbtree_min(t) == NULL && brbtree_max(t) == NULL && brbtree_find(t, 0) == NULL);
+
+  // ascending run first: the appends should leave the buckets full
+  for (key_t k = 0; k < 10 * BRB_BUCKET; k++)
+  {
+    brbtree_insert(t, k % range);
+    counts[k % range]++;
+  }
+  check_bucket_tree(t);
+  assert(t->nodes == 10);
+
+  size_t size = 10 * BRB_BUCKET;
+  for (size_t round = 0; round < 4; round++)
+  {
+    // grow on even rounds, shrink on odd ones
+    const int grow = round % 2 == 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      const key_t key = rand() % range;
+      if (grow ? rand() % 4 != 0 : rand() % 4 == 0)
+      {
+        brbtree_insert(t, key);
+        counts[key]++;
+        size++;
+      }
+      else
+      {
+        assert(brbtree_erase(t, key) == (counts[key] > 0));
+        if (counts[key] > 0)
+        {
+          counts[key]--;
+          size--;
+        }
+      }
+    }
+    check_bucket_tree(t);
+    assert(brbtree_size(t) == size);
+    assert(size == 0 || t->nodes <= size / (BRB_BUCKET / 4) + 1);
+
+    brbtree_to_array(t, res, size);
+    size_t j = 0;
+    for (key_t k = 0; k < range; k++)
+    {
+      const key_t *p = brbtree_find(t, k);
+      assert(counts[k] == 0 ? p == NULL : p != NULL && *p == k);
+      for (size_t c = 0; c < counts[k]; c++)
+      {
+        assert(res[j++] == k);
+      }
+    }
+    assert(j == size);
+    assert(brbtree_find(t, -1) == NULL && brbtree_find(t, range) == NULL);
+    if (size > 0)
+    {
+      assert(*brbtree_min(t) == res[0] && *brbtree_max(t) == res[size - 1]);
+    }
+  }
+
+  // erase everything
+  for (key_t k = 0; k < range; k++)
+  {
+    while (counts[k] > 0)
+    {
+      assert(brbtree_erase(t, k) == 1);
+      counts[k]--;
+    }
+    assert(brbtree_erase(t, k) == 0);
+  }
+  check_bucket_tree(t);
+  assert(brbtree_size(t) == 0 && t->nodes == 0 && t->root == &t->nil);
+
+  delete_brbtree(t);
+  free(res);
+  free(counts);
+}
+
+typedef struct
+{
+  rcu_rbtree *t;
+  key_t even_max;  // even keys in [0, even_max] stay in the tree throughout
+  size_t cap;      // upper bound on the tree size
+  int done;        // set by the writer when it finishes
+  size_t reads;
+} rcu_reader_arg;
+
+// a reader that checks what the writer never touches: the even keys
+static void *rcu_reader(void *p)
+{
+  rcu_reader_arg *arg = (rcu_reader_arg *)p;
+  rcu_rbtree_reader *r = rcu_rbtree_reader_new(arg->t);
+  key_t *res = calloc(arg->cap, sizeof(key_t));
+  unsigned int seed = 7;
+  size_t reads = 0;
+  while (!__atomic_load_n(&arg->done, __ATOMIC_ACQUIRE) || reads == 0)
+  {
+    const key_t key = (key_t)(rand_r(&seed) % (unsigned)(arg->even_max / 2 + 1)) * 2;
+    assert(rcu_rbtree_find(r, key));
+    assert(!rcu_rbtree_find(r, -1 - key));  // negative keys are never inserted
+    key_t lo, hi;
+    assert(rcu_rbtree_min(r, &lo) && lo == 0);
+    assert(rcu_rbtree_max(r, &hi) && hi == arg->even_max);
+    if (reads % 64 == 0)
+    {
+      // every even key shows up once, in order, whatever the odd keys do meanwhile
+      const size_t m = rcu_rbtree_range(r, 0, arg->even_max, res, arg->cap);
+      key_t expect = 0;
+      for (size_t i = 0; i < m; i++)
+      {
+        assert(i == 0 || res[i - 1] <= res[i]);
+        if (res[i] % 2 == 0)
+        {
+          assert(res[i] == expect);
+          expect += 2;
+        }
+      }
+      assert(expect == arg->even_max + 2);
+    }
+    reads++;
+  }
+  __atomic_fetch_add(&arg->reads, reads, __ATOMIC_RELAXED);
+  free(res);
+  rcu_rbtree_reader_delete(r);
+  return NULL;
+}
+
+// readers without locks should see consistent answers while a writer churns
+void test_rcu_tree(const size_t nreaders, const size_t writes, const unsigned int seed)
+{
+  srand(seed);
+  rcu_rbtree *t = new_rcu_rbtree();
+  rcu_rbtree_reader *r = rcu_rbtree_reader_new(t);
+  key_t lo, hi, res[8];
+  assert(!rcu_rbtree_find(r, 0));
+  assert(!rcu_rbtree_min(r, &lo) && !rcu_rbtree_max(r, &hi));
+  assert(rcu_rbtree_range(r, 0, 10, res, 8) == 0);
+
+  // duplicates and range bounds on a quiet tree
+  const key_t keys[] = {5, 3, 5, 9, 1, 5, 7};
+  for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+  {
+    rcu_rbtree_insert(t, keys[i]);
+  }
+  assert(rcu_rbtree_size(t) == 7);
+  assert(rcu_rbtree_range(r, 3, 7, res, 8) == 5);
+  assert(res[0] == 3 && res[1] == 5 && res[2] == 5 && res[3] == 5 && res[4] == 7);
+  assert(rcu_rbtree_range(r, 4, 5, res, 2) == 2 && res[0] == 5 && res[1] == 5);
+  assert(rcu_rbtree_range(r, 7, 3, res, 8) == 0);
+  assert(rcu_rbtree_min(r, &lo) && lo == 1 && rcu_rbtree_max(r, &hi) && hi == 9);
+  assert(rcu_rbtree_erase(t, 5) && rcu_rbtree_erase(t, 5) && rcu_rbtree_erase(t, 5));
+  assert(!rcu_rbtree_erase(t, 5) && !rcu_rbtree_find(r, 5));
+  for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+  {
+    rcu_rbtree_erase(t, keys[i]);
+  }
+  assert(rcu_rbtree_size(t) == 0);
+  rcu_rbtree_reader_delete(r);
+
+  // even keys stay, the writer inserts and erases odd keys in between
+  const key_t even_max = 2000;
+  for (key_t k = 0; k <= even_max; k += 2)
+  {
+    rcu_rbtree_insert(t, k);
+  }
+  rcu_reader_arg arg = {t, even_max, (size_t)even_max / 2 + 1 + writes, 0, 0};
+  pthread_t threads[8];
+  for (size_t i = 0; i < nreaders; i++)
+  {
+    pthread_create(&threads[i], NULL, rcu_reader, &arg);
+  }
+  size_t odd = 0;
+  for (size_t i = 0; i < writes; i++)
+  {
+    const key_t key = (key_t)(rand() % (even_max / 2)) * 2 + 1;
+    if (rand() % 2 == 0)
+    {
+      rcu_rbtree_insert(t, key);
+      odd++;
+    }
+    else if (rcu_rbtree_erase(t, key))
+    {
+      odd--;
+    }
+  }
+  __atomic_store_n(&arg.done, 1, __ATOMIC_RELEASE);
+  for (size_t i = 0; i < nreaders; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  assert(arg.reads >= nreaders);
+  assert(rcu_rbtree_size(t) == (size_t)even_max / 2 + 1 + odd);
+
+  delete_rcu_rbtree(t);
+}
+
+// checks colors, black heights and key order of a lean subtree, returns its black height
+static int check_lean_subtree(const lrb_node *x, const lrb_node **last, size_t *count)
+{
+  if (x == NULL)
+  {
+    return 1;
+  }
+  assert(x->color == RBTREE_BLACK || ((x->link[0] == NULL || x->link[0]->color == RBTREE_BLACK) &&
+                                      (x->link[1] == NULL || x->link[1]->color == RBTREE_BLACK)));
+  const int lh = check_lean_subtree(x->link[0], last, count);
+  assert(*last == NULL || (*last)->key <= x->key);
+  *last = x;
+  (*count)++;
+  const int rh = check_lean_subtree(x->link[1], last, count);
+  assert(lh == rh);
+  return lh + (x->color == RBTREE_BLACK);
+}
+
+static void check_lean_tree(const lrbtree *t)
+{
+  const lrb_node *last = NULL;
+  size_t count = 0;
+  assert(t->root == NULL || t->root->color == RBTREE_BLACK);
+  check_lean_subtree(t->root, &last, &count);
+  assert(count == lrbtree_size(t));
+}
+
+// the top-down tree should hold the same multiset as a table of key counts
+void test_lean_tree(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  const key_t range = (key_t)(n / 4 + 1);  // plenty of duplicates
+  size_t *counts = calloc(range, sizeof(size_t));
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  lrbtree *t = new_lrbtree();
+  lrb_cursor c;
+  assert(lrbtree_min(t) == NULL && lrbtree_max(t) == NULL && lrbtree_find(t, 0) == NULL);
+  assert(!lrbtree_erase(t, 0));
+  lrb_cursor_first(&c, t);
+  assert(!lrb_cursor_valid(&c));
+
+  size_t size = 0;
+  for (size_t round = 0; round < 4; round++)
+  {
+    // grow on even rounds, shrink on odd ones
+    const int grow = round % 2 == 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      const key_t key = rand() % range;
+      if (grow ? rand() % 4 != 0 : rand() % 4 == 0)
+      {
+        lrbtree_insert(t, key);
+        counts[key]++;
+        size++;
+      }
+      else
+      {
+        assert(lrbtree_erase(t, key) == (counts[key] > 0));
+        if (counts[key] > 0)
+        {
+          counts[key]--;
+          size--;
+        }
+      }
+    }
+    check_lean_tree(t);
+    assert(lrbtree_size(t) == size);
+
+    assert(lrbtree_to_array(t, res, n + 1) == size);
+    size_t j = 0;
+    for (key_t k = 0; k < range; k++)
+    {
+      const lrb_node *p = lrbtree_find(t, k);
+      assert(counts[k] == 0 ? p == NULL : p != NULL && p->key == k);
+      for (size_t m = 0; m < counts[k]; m++)
+      {
+        assert(res[j++] == k);
+      }
+    }
+    assert(j == size);
+    if (size > 0)
+    {
+      assert(lrbtree_min(t)->key == res[0] && lrbtree_max(t)->key == res[size - 1]);
+    }
+
+    // the cursor walks the same sequence both ways
+    j = 0;
+    for (lrb_cursor_first(&c, t); lrb_cursor_valid(&c); lrb_cursor_next(&c))
+    {
+      assert(lrb_cursor_node(&c)->key == res[j++]);
+    }
+    assert(j == size);
+    for (lrb_cursor_last(&c, t); lrb_cursor_valid(&c); lrb_cursor_prev(&c))
+    {
+      assert(lrb_cursor_node(&c)->key == res[--j]);
+    }
+    assert(j == 0);
+
+    // seek lands on the first key >= the probe, and steps on from there
+    for (key_t k = -1; k <= range; k += 7)
+    {
+      lrb_cursor_seek(&c, t, k);
+      size_t lb = 0;
+      while (lb < size && res[lb] < k)
+      {
+        lb++;
+      }
+      assert(lrb_cursor_valid(&c) == (lb < size));
+      if (lb < size)
+      {
+        assert(lrb_cursor_node(&c)->key == res[lb]);
+        lrb_cursor_next(&c);
+        assert(lrb_cursor_valid(&c) == (lb + 1 < size));
+        lrb_cursor_seek(&c, t, k);
+        lrb_cursor_prev(&c);
+        assert(lrb_cursor_valid(&c) == (lb > 0));
+      }
+    }
+  }
+
+  // erase everything
+  for (key_t k = 0; k < range; k++)
+  {
+    while (counts[k] > 0)
+    {
+      assert(lrbtree_erase(t, k) == 1);
+      counts[k]--;
+    }
+    assert(lrbtree_erase(t, k) == 0);
+  }
+  check_lean_tree(t);
+  assert(lrbtree_size(t) == 0 && t->root == NULL);
+
+  // sorted input, the common worst case for rebalancing
+  for (key_t k = 0; k < (key_t)n; k++)
+  {
+    lrbtree_insert(t, k);
+  }
+  check_lean_tree(t);
+  assert(lrbtree_to_array(t, res, n) == n && res[0] == 0 && res[n - 1] == (key_t)n - 1);
+
+  delete_lrbtree(t);
+  free(res);
+  free(counts);
+}
+
+static void check_ends(const rbtree *t, const size_t *counts, const size_t nkeys)
+{
+  size_t lo = 0, hi = nkeys;
+  while (lo < nkeys && counts[lo] == 0)
+  {
+    lo++;
+  }
+  while (hi > 0 && counts[hi - 1] == 0)
+  {
+    hi--;
+  }
+  if (lo == nkeys)
+  {
+    assert(rbtree_min(t) == t->nil && rbtree_max(t) == t->nil);
+    return;
+  }
+  assert(rbtree_min(t)->key == (key_t)lo && rbtree_max(t)->key == (key_t)(hi - 1));
+  assert(rbtree_prev(t, rbtree_min(t)) == t->nil && rbtree_next(t, rbtree_max(t)) == t->nil);
+}
+
+// rbtree used as a priority queue: min/max come from the cached ends, which
+// every kind of update has to keep pointing at the outermost nodes
+void test_pop_min_max(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  const size_t nkeys = 512;
+  size_t *counts = calloc(nkeys, sizeof(size_t));
+  rbtree *t = new_rbtree();
+  key_t key;
+  assert(!rbtree_pop_min(t, &key) && !rbtree_pop_max(t, &key));
+  check_ends(t, counts, nkeys);
+
+  for (size_t i = 0; i < n; i++)
+  {
+    const int op = rand() % 6;
+    const key_t k = rand() % (key_t)nkeys;
+    if (op <= 1)
+    {
+      rbtree_insert(t, k);
+      counts[k]++;
+    }
+    else if (op == 2)
+    {
+      // hinted next to either end, the way a timer queue appends
+      node_t *hint = (k % 2 == 0) ? rbtree_min(t) : rbtree_max(t);
+      rbtree_insert_hint(t, hint, k);
+      counts[k]++;
+    }
+    else if (op == 3)
+    {
+      if (rbtree_pop_min(t, &key))
+      {
+        assert(counts[key] > 0);
+        counts[key]--;
+      }
+    }
+    else if (op == 4)
+    {
+      if (rbtree_pop_max(t, &key))
+      {
+        assert(counts[key] > 0);
+        counts[key]--;
+      }
+    }
+    else
+    {
+      node_t *p = rbtree_find(t, k);
+      if (p != NULL)
+      {
+        rbtree_erase(t, p);
+        counts[k]--;
+      }
+    }
+    check_ends(t, counts, nkeys);
+  }
+
+  // draining from both ends gives the keys in order
+  key_t lo = INT32_MIN, hi = INT32_MAX;
+  while (rbtree_size(t) > 0)
+  {
+    assert(rbtree_pop_min(t, &key) && key >= lo);
+    lo = key;
+    counts[key]--;
+    if (rbtree_pop_max(t, &key))
+    {
+      assert(key <= hi && key >= lo);
+      hi = key;
+      counts[key]--;
+    }
+    check_ends(t, counts, nkeys);
+  }
+  assert(!rbtree_pop_min(t, &key) && !rbtree_pop_max(t, &key));
+  delete_rbtree(t);
+
+  // trees rebuilt in one go (from_sorted, split) start with the right ends too
+  key_t sorted[] = {1, 1, 2, 3, 5, 8, 13, 21};
+  t = rbtree_from_sorted(sorted, 8);
+  rbtree *r = rbtree_split(t, 4);
+  check_tree_keys(t, sorted, 4);
+  check_tree_keys(r, sorted + 4, 4);
+  assert(rbtree_pop_max(t, &key) && key == 3 && rbtree_pop_min(r, &key) && key == 5);
+  assert(rbtree_min(t)->key == 1 && rbtree_max(t)->key == 2 && rbtree_min(r)->key == 8);
+  delete_rbtree(r);
+  delete_rbtree(t);
+  free(counts);
+}
+
+#ifdef RBTREE_INTERVAL
+// max_hi must be the largest interval end below every node
+static key_t max_traverse(const node_t *p, const node_t *nil)
+{
+  if (p == nil)
+  {
+    return INT32_MIN;
+  }
+  key_t m = p->hi;
+  const key_t l = max_traverse(p->left, nil);
+  const key_t r = max_traverse(p->right, nil);
+  m = l > m ? l : m;
+  m = r > m ? r : m;
+  assert(p->max_hi == m);
+  return m;
+}
+
+typedef struct
+{
+  key_t lo, hi;
+  size_t count;
+  key_t last;  // start of the previous visit, to check the order
+} overlap_arg;
+
+static int collect_overlap(node_t *p, void *arg)
+{
+  overlap_arg *a = (overlap_arg *)arg;
+  assert(p->key <= a->hi && p->hi >= a->lo);
+  assert(a->count == 0 || p->key >= a->last);
+  a->last = p->key;
+  a->count++;
+  return 0;
+}
+
+// overlap queries against a scan of all live intervals, through inserts,
+// erases and the operations that relink the tree wholesale
+static void check_overlaps(const rbtree *t, node_t **nodes, const size_t m, const key_t span)
+{
+  max_traverse(t->root, t->nil);
+  for (int q = 0; q < 20; q++)
+  {
+    const key_t lo = rand() % span - 10;
+    const key_t hi = lo + rand() % (span / 20 + 1);
+    size_t expected = 0;
+    node_t *first = NULL;
+    for (size_t i = 0; i < m; i++)
+    {
+      if (nodes[i]->key <= hi && nodes[i]->hi >= lo)
+      {
+        expected++;
+        first = (first == NULL || nodes[i]->key < first->key) ? nodes[i] : first;
+      }
+    }
+    node_t *p = rbtree_interval_overlaps(t, lo, hi);
+    assert((p == NULL) == (first == NULL));
+    assert(p == NULL || (p->key == first->key && p->hi >= lo));
+
+    overlap_arg arg = {.lo = lo, .hi = hi};
+    assert(rbtree_interval_foreach(t, lo, hi, collect_overlap, &arg) == expected);
+    assert(arg.count == expected);
+  }
+}
+
+void test_interval_tree(const size_t n, const unsigned int seed)
+{
+  srand(seed);
+  const key_t span = (key_t)(4 * n);
+  rbtree *t = new_rbtree();
+  node_t **nodes = calloc(n, sizeof(node_t *));
+  size_t m = 0;
+  assert(rbtree_interval_overlaps(t, 0, span) == NULL);
+
+  for (size_t i = 0; i < n; i++)
+  {
+    const key_t lo = rand() % span;
+    // mostly short intervals and a few long ones that cover many starts
+    const key_t len = (i % 50 == 0) ? rand() % (span / 4) : rand() % 16;
+    nodes[m++] = (i % 10 == 0) ? rbtree_insert(t, lo) : rbtree_insert_interval(t, lo, lo + len);
+    if (i % (n / 10) == 0)
+    {
+      check_overlaps(t, nodes, m, span);
+    }
+  }
+  check_overlaps(t, nodes, m, span);
+
+  // erase a third, hitting every unlink case
+  for (size_t i = 0; i < n / 3; i++)
+  {
+    const size_t j = (size_t)rand() % m;
+    rbtree_erase(t, nodes[j]);
+    nodes[j] = nodes[--m];
+  }
+  check_overlaps(t, nodes, m, span);
+  key_t key;
+  rbtree_pop_min(t, &key);
+  rbtree_pop_max(t, &key);
+  m = 0;
+  for (node_t *p = rbtree_min(t); p != t->nil; p = rbtree_next(t, p))
+  {
+    nodes[m++] = p;
+  }
+  check_overlaps(t, nodes, m, span);
+
+  // split and join relink subtrees and rotate; the interval ends move with their nodes
+  rbtree *r = rbtree_split(t, span / 2);
+  max_traverse(t->root, t->nil);
+  max_traverse(r->root, r->nil);
+  assert(rbtree_join(t, span / 2, r) == 0);
+  nodes[m++] = rbtree_find(t, span / 2);
+  check_overlaps(t, nodes, m, span);
+  delete_rbtree(r);
+
+  // a sorted batch large enough to rebuild the tree from the merged nodes
+  key_t *batch = calloc(2 * n, sizeof(key_t));
+  for (size_t i = 0; i < 2 * n; i++)
+  {
+    batch[i] = rand() % span;
+  }
+  rbtree_insert_many(t, batch, 2 * n);
+  nodes = realloc(nodes, rbtree_size(t) * sizeof(node_t *));
+  m = 0;
+  for (node_t *p = rbtree_min(t); p != t->nil; p = rbtree_next(t, p))
+  {
+    nodes[m++] = p;
+  }
+  assert(m == rbtree_size(t));
+  check_overlaps(t, nodes, m, span);
+
+  // images cannot hold the interval ends, so saving must refuse and leave the file alone
+  char path[] = "/tmp/rbtree-image-XXXXXX";
+  const int fd = mkstemp(path);
+  assert(fd >= 0);
+  assert(write(fd, "keep", 4) == 4);
+  close(fd);
+  assert(rbtree_save(t, path) == -1);
+  struct stat st;
+  assert(stat(path, &st) == 0 && st.st_size == 4);
+  unlink(path);
+
+  free(batch);
+  free(nodes);
+  delete_rbtree(t);
+}
+#endif
+
+int main(void)
+{
+  test_init();
+  test_insert_single(1024);
+  test_find_single(512, 1024);
+  test_erase_root(128);
+  test_find_erase_fixed();
+  test_minmax_suite();
+  test_to_array_suite();
+  test_distinct_values();
+  test_duplicate_values();
+  test_multi_instance();
+  test_find_erase_rand(10000, 17);
+  test_pool_tree(10000, 17);
+  test_from_array(100);
+  test_cursor(1000, 3);
+  test_bounds_range();
+  test_order_statistics(3000, 5);
+  test_compact_tree(5000, 11);
+  test_generic_map(2000, 13);
+  test_sharded_tree(4, 20000);
+  test_insert_many(21);
+  test_split_join(500, 23);
+  test_set_operations(20000, 15000, 29);
+  test_set_operations(3000, 0, 31);
+  test_set_operations(0, 3000, 37);
+  test_set_operations(10, 5000, 41);
+  test_persistent_tree(10000, 43);
+#ifndef RBTREE_INTERVAL
+  test_image(20000, 47);
+#endif
+  test_stats(5000, 53);
+  test_to_array_large(300000, 59);
+  test_insert_hint(20000, 61);
+  test_counted_multiset(50000, 300, 67);
+  test_frozen(100000, 71);
+  test_bucket_tree(50000, 73);
+  test_rcu_tree(3, 200000, 79);
+  test_lean_tree(50000, 83);
+  test_pop_min_max(100000, 89);
+#ifdef RBTREE_INTERVAL
+  test_interval_tree(20000, 97);
+#endif
   printf("Passed all tests!\n");
 }